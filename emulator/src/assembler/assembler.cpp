@@ -1,219 +1,252 @@
+#include "assembler.h"
+#include "perfecthash.h"
+
+#include <algorithm>
 #include <cctype>
 #include <cstdint>
-#include <fstream>
-#include <iostream>
+#include <limits>
 #include <unordered_map>
 #include <stdexcept>
 #include <sstream>
+#include <string_view>
 
 namespace Assembler {
 
-using Word = std::int16_t;
 constexpr int WORD_WIDTH = 16;
 
-void PrintBinary(std::iostream &out, Word x, int bits = WORD_WIDTH - 1) {
-  std::string s;
-  while (bits--)
-    out << ((x >> bits) & 1);
+// The fields of a C-instruction: 111a cccc ccdd djjj
+constexpr std::uint16_t C_INSTRUCTION = 0b111 << 13;
+constexpr int COMPUTATION_SHIFT = 6;
+constexpr int DESTINATION_SHIFT = 3;
+constexpr std::uint16_t ADDRESS_MASK = 0x7fff;
+
+// The symbols every program can use
+constexpr PerfectHashTable<Word, 64> BASE_SYMBOLS({
+  {"SP", 0}, {"LCL", 1}, {"ARG", 2}, {"THIS", 3}, {"THAT", 4},
+  {"SCREEN", 16384}, {"KBD", 24576},
+  {"R0", 0}, {"R1", 1}, {"R2", 2}, {"R3", 3},
+  {"R4", 4}, {"R5", 5}, {"R6", 6}, {"R7", 7},
+  {"R8", 8}, {"R9", 9}, {"R10", 10}, {"R11", 11},
+  {"R12", 12}, {"R13", 13}, {"R14", 14}, {"R15", 15}
+});
+
+constexpr PerfectHashTable<Word, 16> DESTINATIONS({
+  {"",    0b000},
+  {"M",   0b001},
+  {"D",   0b010},
+  {"MD",  0b011},
+  {"A",   0b100},
+  {"AM",  0b101},
+  {"AD",  0b110},
+  {"AMD", 0b111}
+});
+
+constexpr PerfectHashTable<Word, 64> COMPUTATIONS({
+  {"0",   0b0101010}, // same
+  {"1",   0b0111111}, // same
+  {"-1",  0b0111010},
+  {"D",   0b0001100},
+  {"A",   0b0110000},
+  {"!D",  0b0001101},
+  {"!A",  0b0110001},
+  {"-D",  0b0001111},
+  {"-A",  0b0110011},
+  {"D+1", 0b0011111},
+  {"A+1", 0b0110111},
+  {"D-1", 0b0001110},
+  {"A-1", 0b0110010},
+  {"D+A", 0b0000010},
+  {"D-A", 0b0010011},
+  {"A-D", 0b0000111},
+  {"D&A", 0b0000000},
+  {"D|A", 0b0010101},
+  {"M",   0b1110000},
+  {"!M",  0b1110001},
+  {"-M",  0b1110011}, // same as -A
+  {"M+1", 0b1110111}, // same as A+1
+  {"M-1", 0b1110010}, // same as A-1
+  {"D+M", 0b1000010}, // same as D+A
+  {"D-M", 0b1010011}, // same as D-A
+  {"M-D", 0b1000111}, // same as A-D
+  {"D&M", 0b1000000},
+  {"D|M", 0b1010101}
+});
+
+constexpr PerfectHashTable<Word, 16> JUMPS({
+  {"",    0b000},
+  {"JGT", 0b001},
+  {"JEQ", 0b010},
+  {"JGE", 0b011},
+  {"JLT", 0b100},
+  {"JNE", 0b101},
+  {"JLE", 0b110},
+  {"JMP", 0b111}
+});
+
+// An A-instruction with a symbol, resolved once every label is known
+struct Fixup {
+  std::size_t index;
+  std::string_view symbol;
+};
+
+bool IsSpace(char c) {
+  return std::isspace(static_cast<unsigned char>(c));
 }
 
-std::unordered_map<std::string, Word> baseSymbolTable;
-std::unordered_map<std::string, std::string> destinations;
-std::unordered_map<std::string, std::string> computations;
-std::unordered_map<std::string, std::string> jumps;
-void initialize() {
-  baseSymbolTable["SP"] =     0;
-  baseSymbolTable["LCL"] =    1;
-  baseSymbolTable["ARG"] =    2;
-  baseSymbolTable["THIS"] =   3;
-  baseSymbolTable["THAT"] =   4;
-  baseSymbolTable["SCREEN"] = 16384;
-  baseSymbolTable["KBD"] =    24576;
-  for (Word i = 0; i < 16; ++i)
-    baseSymbolTable["R" + std::to_string(i)] = i;
-
-  destinations[""]    = "000";
-  destinations["M"]   = "001";
-  destinations["D"]   = "010";
-  destinations["MD"]  = "011";
-  destinations["A"]   = "100";
-  destinations["AM"]  = "101";
-  destinations["AD"]  = "110";
-  destinations["AMD"] = "111";
-
-  computations["0"]   = "0101010"; // same
-  computations["1"]   = "0111111"; // same
-  computations["-1"]  = "0111010"; //
-  computations["D"]   = "0001100";
-  computations["A"]   = "0110000";
-  computations["!D"]  = "0001101";
-  computations["!A"]  = "0110001";
-  computations["-D"]  = "0001111"; //
-  computations["-A"]  = "0110011"; //
-  computations["D+1"] = "0011111"; //
-  computations["A+1"] = "0110111"; //
-  computations["D-1"] = "0001110"; //
-  computations["A-1"] = "0110010"; //
-  computations["D+A"] = "0000010"; //
-  computations["D-A"] = "0010011"; //
-  computations["A-D"] = "0000111"; //
-  computations["D&A"] = "0000000";
-  computations["D|A"] = "0010101";
-  computations["M"]   = "1110000";
-  computations["!M"]  = "1110001";
-  computations["-M"]  = "1110011"; // same as -A
-  computations["M+1"] = "1110111"; // same as A+1
-  computations["M-1"] = "1110010"; // same as A-1
-  computations["D+M"] = "1000010"; // same as D+A
-  computations["D-M"] = "1010011"; // same as D-A
-  computations["M-D"] = "1000111"; // same as A-D
-  computations["D&M"] = "1000000";
-  computations["D|M"] = "1010101";
-
-  jumps[""]     = "000";
-  jumps["JGT"]  = "001";
-  jumps["JEQ"]  = "010";
-  jumps["JGE"]  = "011";
-  jumps["JLT"]  = "100";
-  jumps["JNE"]  = "101";
-  jumps["JLE"]  = "110";
-  jumps["JMP"]  = "111";
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
 }
 
-bool IsNumber(const std::string &str) {
-  for (const auto &c : str)
-    if (!std::isdigit(c)) return false;
-  return true;
+Word EncodeAddress(Word address) {
+  return static_cast<Word>(static_cast<std::uint16_t>(address) & ADDRESS_MASK);
 }
 
-std::string assemble(const std::string &assembly) {
-  std::stringstream inputFile(assembly);
-  std::stringstream outputFile;
-
-  std::string line;
+[[noreturn]] void ThrowError(int asmLineNumber, const std::string &message,
+                             std::string_view token) {
+  throw std::runtime_error("Line " + std::to_string(asmLineNumber) + ": " +
+                           message + " " + std::string(token));
+}
 
-  std::unordered_map<std::string, Word> symbolTable(baseSymbolTable);
-  std::unordered_map<std::string, Word> labelTable;
-  Word hackLineNumber = 0;
-  Word symbolNumber = 16;
-  int asmLineNumber = 0;
-  while (std::getline(inputFile, line)) {
-    std::stringstream input(line);
+// Same range as std::stoi: the address wraps around to 15 bits, but it has to
+// fit into an int
+Word ParseAddress(std::string_view digits, int asmLineNumber) {
+  if (digits.empty()) ThrowError(asmLineNumber, "missing address", digits);
+  long long value = 0;
+  for (char c : digits) {
+    value = value * 10 + (c - '0');
+    if (value > std::numeric_limits<int>::max())
+      ThrowError(asmLineNumber, "address out of range", digits);
+  }
+  return static_cast<Word>(value);
+}
 
-    char front;
-    input >> std::ws >> front;
+// The view up to the first space, which starts an inline comment
+std::string_view BeforeSpace(std::string_view str) {
+  return str.substr(0, str.find(' '));
+}
 
-    if (front == '(') {
-      // Label
-      std::string label;
-      std::getline(input, label, ')');
-      labelTable[label] = hackLineNumber;
-    } else if (front != '/') {
-      // A or C instruction
-      ++hackLineNumber;
-    }
-  }
+std::vector<Word> assemble(const std::string &assembly, std::string *symbols) {
+  std::vector<Word> machineCode;
+  std::stringstream symbolFile;
 
-  inputFile.clear();
-  inputFile.seekg(std::ios::beg);
-  asmLineNumber = 0;
-  while (std::getline(inputFile, line)) {
+  // Labels can be used before they are defined, and a label defined twice
+  // takes its last address everywhere, so symbols are only resolved at the
+  // end, when every label is known. All the names are views into assembly
+  std::unordered_map<std::string_view, Word> labelTable;
+  std::vector<Fixup> fixups;
+  std::string_view input(assembly);
+  int asmLineNumber = 0;
+  std::size_t lineBegin = 0;
+  while (lineBegin < input.size()) {
     ++asmLineNumber;
-    std::stringstream input(line);
+    std::size_t lineEnd = input.find('\n', lineBegin);
+    if (lineEnd == std::string_view::npos) lineEnd = input.size();
+    std::size_t begin = lineBegin, end = lineEnd;
+    lineBegin = lineEnd + 1;
 
-    input >> std::ws;
-    std::getline(input, line);
-    input = std::stringstream(line);
-    char front;
-    input >> front;
+    while (begin < end && IsSpace(input[begin])) ++begin;
+    while (end > begin && IsSpace(input[end - 1])) --end;
+    if (begin == end) continue;
+    std::string_view line = input.substr(begin, end - begin);
 
-    if (front == '@') {
+    if (line.front() == '(') {
+      // Label
+      auto label = line.substr(1, line.find(')') - 1);
+      labelTable[label] = static_cast<Word>(machineCode.size());
+      if (symbols)
+        symbolFile << machineCode.size() << " " << label << "\n";
+    } else if (line.front() == '@') {
       // A instruction
-      outputFile << "0";
-
-      std::string addressStr;
-      input >> addressStr;
-
-      Word address;
-      if (IsNumber(addressStr)) {
-        address = static_cast<Word>(std::stoi(addressStr));
+      std::size_t addressBegin = 1;
+      while (addressBegin < line.size() && IsSpace(line[addressBegin]))
+        ++addressBegin;
+      std::size_t addressEnd = addressBegin;
+      while (addressEnd < line.size() && !IsSpace(line[addressEnd]))
+        ++addressEnd;
+      auto address = line.substr(addressBegin, addressEnd - addressBegin);
+
+      if (std::all_of(address.begin(), address.end(), IsDigit)) {
+        machineCode.push_back(
+            EncodeAddress(ParseAddress(address, asmLineNumber)));
       } else {
-        auto addressIt = labelTable.find(addressStr);
-        if (addressIt == labelTable.end()) {
-          addressIt = symbolTable.find(addressStr);
-          if (addressIt == symbolTable.end()) {
-            symbolTable[addressStr] = address = symbolNumber++;
-          } else {
-            address = addressIt->second;
-          }
-        } else {
-          address = addressIt->second;
-        }
+        fixups.push_back({machineCode.size(), address});
+        machineCode.push_back(0);
       }
-      PrintBinary(outputFile, address);
-      outputFile << std::endl;
-    } else if (front != '(' && front != '/' && !std::isspace(front)) {
+    } else if (line.front() != '/') {
       // C instruction
-      for (int i = 0; i < WORD_WIDTH - 13; ++i)
-        outputFile << "1";
-
-      while (std::isspace(line.back()))
-        line.pop_back();
-
       auto destPos = line.find('=');
-      std::string destination;
-      if (destPos == std::string::npos) {
+      Word destination, computation, jump;
+      if (destPos == std::string_view::npos) {
         // No destination
         destPos = 0;
-        destination = destinations[""];
+        destination = 0;
       } else {
         // Destination
         auto destStr = line.substr(0, destPos++);
-        auto destIt = destinations.find(destStr);
-        if (destIt == destinations.end())
-          throw std::runtime_error("Line " + std::to_string(asmLineNumber) +
-              ": invalid destination " + destStr);
-        destination = destIt->second;
+        auto destIt = DESTINATIONS.find(destStr);
+        if (!destIt) ThrowError(asmLineNumber, "invalid destination", destStr);
+        destination = *destIt;
       }
 
       auto compPos = line.find(';');
-      if (compPos == std::string::npos) {
+      if (compPos == std::string_view::npos) {
         // Compuation (no jump)
-        auto compStr = line.substr(destPos);
-        compStr = compStr.substr(0, compStr.find_first_of(' '));
-        auto compIt = computations.find(compStr);
-        if (compIt == computations.end())
-          throw std::runtime_error("Line " + std::to_string(asmLineNumber) +
-              ": invalid computation " + compStr);
-        outputFile << compIt->second;
-
-        outputFile << destination;
-
-        outputFile << jumps[""];
+        auto compStr = BeforeSpace(line.substr(destPos));
+        auto compIt = COMPUTATIONS.find(compStr);
+        if (!compIt) ThrowError(asmLineNumber, "invalid computation", compStr);
+        computation = *compIt;
+        jump = 0;
       } else {
         // Compuation and jump
         auto compStr = line.substr(destPos, compPos - destPos);
-        auto compIt = computations.find(compStr);
-        if (compIt == computations.end())
-          throw std::runtime_error("Line " + std::to_string(asmLineNumber) +
-              ": invalid computation " + compStr);
-        outputFile << compIt->second;
-
-        outputFile << destination;
-
-        auto jumpStr = line.substr(compPos + 1);
-        jumpStr = jumpStr.substr(0, jumpStr.find_first_of(' '));
-        auto jumpIt = jumps.find(jumpStr);
-        if (jumpIt == jumps.end())
-          throw std::runtime_error("Line " + std::to_string(asmLineNumber) +
-              ": invalid jump " + jumpStr);
-        outputFile << jumpIt->second;
+        auto compIt = COMPUTATIONS.find(compStr);
+        if (!compIt) ThrowError(asmLineNumber, "invalid computation", compStr);
+        computation = *compIt;
+
+        auto jumpStr = BeforeSpace(line.substr(compPos + 1));
+        auto jumpIt = JUMPS.find(jumpStr);
+        if (!jumpIt) ThrowError(asmLineNumber, "invalid jump", jumpStr);
+        jump = *jumpIt;
       }
-      outputFile << std::endl;
+      machineCode.push_back(static_cast<Word>(C_INSTRUCTION |
+          computation << COMPUTATION_SHIFT |
+          destination << DESTINATION_SHIFT | jump));
     }
   }
 
-  return outputFile.str();
+  // Whatever is not a label is a predefined symbol or a variable. Variables
+  // get addresses from 16 on, in the order they are first used
+  std::unordered_map<std::string_view, Word> variableTable;
+  Word symbolNumber = 16;
+  for (const auto &fixup : fixups) {
+    Word address;
+    auto labelIt = labelTable.find(fixup.symbol);
+    if (labelIt != labelTable.end()) {
+      address = labelIt->second;
+    } else if (auto baseIt = BASE_SYMBOLS.find(fixup.symbol)) {
+      address = *baseIt;
+    } else {
+      auto [variableIt, inserted] =
+          variableTable.try_emplace(fixup.symbol, symbolNumber);
+      if (inserted) ++symbolNumber;
+      address = variableIt->second;
+    }
+    machineCode[fixup.index] = EncodeAddress(address);
+  }
+
+  if (symbols) *symbols = symbolFile.str();
+  return machineCode;
+}
+
+std::string toText(const std::vector<Word> &machineCode) {
+  std::string text;
+  text.reserve(machineCode.size() * (WORD_WIDTH + 1));
+  for (Word instruction : machineCode) {
+    for (int bit = WORD_WIDTH - 1; bit >= 0; --bit)
+      text += static_cast<char>('0' + ((instruction >> bit) & 1));
+    text += '\n';
+  }
+  return text;
 }
 
 } // namespace Assembler
@@ -1,11 +1,21 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace Assembler {
 
-void initialize();
-std::string assemble(const std::string &assembly);
+using Word = std::int16_t;
+
+// Returns the machine code, one word per instruction. If symbols is given, it
+// is set to a symbol file with one "address label" line per label, in the order
+// of the addresses
+std::vector<Word> assemble(const std::string &assembly,
+                           std::string *symbols = nullptr);
+// The machine code as text, one line of 16 '0' and '1' characters per
+// instruction, like the .hack files of nand2tetris
+std::string toText(const std::vector<Word> &machineCode);
 
 } // namespace Assembler
 
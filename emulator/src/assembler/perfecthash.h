@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace Assembler {
+
+// A fixed map from strings to values, built at compile time. The constructor
+// searches for a hash seed under which no two keys share a slot, so a lookup
+// hashes the key once and compares it with a single entry
+template <typename Value, std::size_t SIZE>
+class PerfectHashTable {
+public:
+  struct Entry {
+    std::string_view key;
+    Value value;
+  };
+
+  template <std::size_t N>
+  constexpr explicit PerfectHashTable(const Entry (&entries)[N]) :
+    seed_(0),
+    slots_()
+  {
+    static_assert(N <= SIZE, "More keys than slots");
+    for (std::uint32_t seed = 1; seed < MAX_SEED; ++seed) {
+      if (tryBuild(entries, seed)) return;
+    }
+    throw std::logic_error("No perfect hash seed found; increase SIZE");
+  }
+
+  // Returns nullptr if key is not in the table
+  constexpr const Value *find(std::string_view key) const {
+    const Slot &slot = slots_[Hash(key, seed_) % SIZE];
+    return slot.used && slot.key == key ? &slot.value : nullptr;
+  }
+
+private:
+  static constexpr std::uint32_t MAX_SEED = 1 << 16;
+
+  struct Slot {
+    constexpr Slot() : used(false), key(), value() {}
+
+    bool used;
+    std::string_view key;
+    Value value;
+  };
+
+  // FNV-1a with the seed in place of the offset basis, followed by the
+  // MurmurHash3 finalizer, as the low bits of FNV alone mix too little for
+  // small tables
+  static constexpr std::uint32_t Hash(std::string_view key,
+                                      std::uint32_t seed) {
+    std::uint32_t hash = seed;
+    for (char c : key) {
+      hash ^= static_cast<unsigned char>(c);
+      hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+  }
+
+  template <std::size_t N>
+  constexpr bool tryBuild(const Entry (&entries)[N], std::uint32_t seed) {
+    slots_ = {};
+    for (const auto &entry : entries) {
+      Slot &slot = slots_[Hash(entry.key, seed) % SIZE];
+      if (slot.used) return false;
+      slot.used = true;
+      slot.key = entry.key;
+      slot.value = entry.value;
+    }
+    seed_ = seed;
+    return true;
+  }
+
+  std::uint32_t seed_;
+  std::array<Slot, SIZE> slots_;
+};
+
+} // namespace Assembler
@@ -0,0 +1,227 @@
+#include "intrinsics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace Intrinsics {
+
+namespace {
+
+// A native string is a single heap block holding its maximum length, its
+// length and then its characters
+constexpr Word STRING_MAX_LENGTH = 0, STRING_LENGTH = 1, STRING_CHARS = 2;
+
+Word MathAbs(Word *, Heap &, const Word *arguments) {
+  return static_cast<Word>(arguments[0] < 0 ? -arguments[0] : arguments[0]);
+}
+
+Word MathMultiply(Word *, Heap &, const Word *arguments) {
+  return static_cast<Word>(arguments[0] * arguments[1]);
+}
+
+Word MathDivide(Word *, Heap &, const Word *arguments) {
+  if (arguments[1] == 0)
+    throw std::runtime_error("Division by zero");
+  return static_cast<Word>(arguments[0] / arguments[1]);
+}
+
+Word MathMin(Word *, Heap &, const Word *arguments) {
+  return std::min(arguments[0], arguments[1]);
+}
+
+Word MathMax(Word *, Heap &, const Word *arguments) {
+  return std::max(arguments[0], arguments[1]);
+}
+
+Word MathSqrt(Word *, Heap &, const Word *arguments) {
+  if (arguments[0] < 0)
+    throw std::runtime_error("Cannot compute the square root of a negative number");
+  Word root = 0;
+  while ((root + 1) * (root + 1) <= arguments[0]) ++root;
+  return root;
+}
+
+Word MemoryInit(Word *, Heap &heap, const Word *) {
+  heap.reset();
+  return 0;
+}
+
+Word MemoryPeek(Word *memory, Heap &, const Word *arguments) {
+  return memory[arguments[0]];
+}
+
+Word MemoryPoke(Word *memory, Heap &, const Word *arguments) {
+  memory[arguments[0]] = arguments[1];
+  return 0;
+}
+
+Word MemoryAlloc(Word *memory, Heap &heap, const Word *arguments) {
+  return heap.alloc(memory, arguments[0]);
+}
+
+Word MemoryDeAlloc(Word *memory, Heap &heap, const Word *arguments) {
+  heap.deAlloc(memory, arguments[0]);
+  return 0;
+}
+
+Word StringNew(Word *memory, Heap &heap, const Word *arguments) {
+  if (arguments[0] < 0)
+    throw std::runtime_error("Maximum length of a string must be non-negative");
+  Word string = heap.alloc(memory, static_cast<Word>(arguments[0] + STRING_CHARS));
+  memory[string + STRING_MAX_LENGTH] = arguments[0];
+  memory[string + STRING_LENGTH] = 0;
+  return string;
+}
+
+Word StringDispose(Word *memory, Heap &heap, const Word *arguments) {
+  heap.deAlloc(memory, arguments[0]);
+  return 0;
+}
+
+Word StringLength(Word *memory, Heap &, const Word *arguments) {
+  return memory[arguments[0] + STRING_LENGTH];
+}
+
+Word &StringChar(Word *memory, Word string, Word index) {
+  if (index < 0 || index >= memory[string + STRING_LENGTH])
+    throw std::runtime_error("String index out of bounds");
+  return memory[string + STRING_CHARS + index];
+}
+
+Word StringCharAt(Word *memory, Heap &, const Word *arguments) {
+  return StringChar(memory, arguments[0], arguments[1]);
+}
+
+Word StringSetCharAt(Word *memory, Heap &, const Word *arguments) {
+  StringChar(memory, arguments[0], arguments[1]) = arguments[2];
+  return 0;
+}
+
+Word StringAppendChar(Word *memory, Heap &, const Word *arguments) {
+  Word string = arguments[0];
+  Word &length = memory[string + STRING_LENGTH];
+  if (length >= memory[string + STRING_MAX_LENGTH])
+    throw std::runtime_error("String is full");
+  memory[string + STRING_CHARS + length] = arguments[1];
+  ++length;
+  return string;
+}
+
+Word StringEraseLastChar(Word *memory, Heap &, const Word *arguments) {
+  Word &length = memory[arguments[0] + STRING_LENGTH];
+  if (length == 0)
+    throw std::runtime_error("String is empty");
+  --length;
+  return 0;
+}
+
+Word StringIntValue(Word *memory, Heap &, const Word *arguments) {
+  Word string = arguments[0];
+  Word length = memory[string + STRING_LENGTH];
+  const Word *chars = memory + string + STRING_CHARS;
+  bool negative = length > 0 && chars[0] == '-';
+  // Wraps around past 16 bits, as the Jack OS does
+  std::uint16_t value = 0;
+  for (Word i = negative ? 1 : 0; i < length && chars[i] >= '0' && chars[i] <= '9'; ++i)
+    value = static_cast<std::uint16_t>(value * 10 + (chars[i] - '0'));
+  return static_cast<Word>(negative ? -value : value);
+}
+
+Word StringSetInt(Word *memory, Heap &, const Word *arguments) {
+  Word string = arguments[0];
+  std::string digits = std::to_string(arguments[1]);
+  if (static_cast<int>(digits.size()) > memory[string + STRING_MAX_LENGTH])
+    throw std::runtime_error("String is too short for the number");
+  std::copy(digits.begin(), digits.end(), memory + string + STRING_CHARS);
+  memory[string + STRING_LENGTH] = static_cast<Word>(digits.size());
+  return 0;
+}
+
+Word StringNewLine(Word *, Heap &, const Word *) {
+  return 128;
+}
+
+Word StringBackSpace(Word *, Heap &, const Word *) {
+  return 129;
+}
+
+Word StringDoubleQuote(Word *, Heap &, const Word *) {
+  return '"';
+}
+
+const std::vector<Intrinsic> INTRINSICS = {
+  {"Math.abs", 1, MathAbs, "", ""},
+  {"Math.multiply", 2, MathMultiply, "", ""},
+  {"Math.divide", 2, MathDivide, "", ""},
+  {"Math.min", 2, MathMin, "", ""},
+  {"Math.max", 2, MathMax, "", ""},
+  {"Math.sqrt", 1, MathSqrt, "", ""},
+  {"Memory.peek", 1, MemoryPeek, "", ""},
+  {"Memory.poke", 2, MemoryPoke, "", ""},
+  {"Memory.init", 0, MemoryInit, "Memory", ""},
+  {"Memory.alloc", 1, MemoryAlloc, "Memory", ""},
+  {"Memory.deAlloc", 1, MemoryDeAlloc, "Memory", ""},
+  {"String.new", 1, StringNew, "String", "Memory"},
+  {"String.dispose", 1, StringDispose, "String", "Memory"},
+  {"String.length", 1, StringLength, "String", ""},
+  {"String.charAt", 2, StringCharAt, "String", ""},
+  {"String.setCharAt", 3, StringSetCharAt, "String", ""},
+  {"String.appendChar", 2, StringAppendChar, "String", ""},
+  {"String.eraseLastChar", 1, StringEraseLastChar, "String", ""},
+  {"String.intValue", 1, StringIntValue, "String", ""},
+  {"String.setInt", 2, StringSetInt, "String", ""},
+  {"String.newLine", 0, StringNewLine, "", ""},
+  {"String.backSpace", 0, StringBackSpace, "", ""},
+  {"String.doubleQuote", 0, StringDoubleQuote, "", ""}
+};
+
+} // namespace
+
+Heap::Heap() :
+  top_(BASE),
+  free_()
+{
+
+}
+
+void Heap::reset() {
+  top_ = BASE;
+  free_.clear();
+}
+
+Word Heap::alloc(Word *memory, Word size) {
+  if (size <= 0)
+    throw std::runtime_error("Size of an allocation must be positive");
+
+  auto it = std::find_if(free_.begin(), free_.end(),
+      [size](const std::pair<Word, Word> &block) { return block.second >= size; });
+  if (it != free_.end()) {
+    Word block = it->first;
+    free_.erase(it);
+    return block;
+  }
+
+  if (size >= END - top_)
+    throw std::runtime_error("Heap overflow");
+  memory[top_] = size;
+  Word block = static_cast<Word>(top_ + 1);
+  top_ = static_cast<Word>(top_ + size + 1);
+  return block;
+}
+
+void Heap::deAlloc(Word *memory, Word block) {
+  free_.emplace_back(block, memory[block - 1]);
+}
+
+const Intrinsic *find(std::string_view name) {
+  auto it = std::find_if(INTRINSICS.begin(), INTRINSICS.end(),
+      [name](const Intrinsic &intrinsic) { return intrinsic.name == name; });
+  return it == INTRINSICS.end() ? nullptr : &*it;
+}
+
+const std::vector<Intrinsic> &all() {
+  return INTRINSICS;
+}
+
+} // namespace Intrinsics
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using Word = std::int16_t;
+
+// Native implementations of Jack OS functions, which the VM interpreter can
+// run in place of the VM code of those functions
+namespace Intrinsics {
+
+// The heap of the native Memory functions. As in the Jack OS, it spans from
+// the end of the stack to the display, and the size of a block is kept in
+// the word before it
+class Heap {
+public:
+  static constexpr Word BASE = 2048, END = 16384;
+
+  Heap();
+
+  void reset();
+  Word alloc(Word *memory, Word size);
+  void deAlloc(Word *memory, Word block);
+
+private:
+  Word top_;
+  // Address and size of each freed block, reused first fit
+  std::vector<std::pair<Word, Word>> free_;
+};
+
+// Gets the memory, the heap and the arguments of the call, and returns the
+// value the call pushes; void functions return 0, as their VM code would
+using Function = Word (*)(Word *memory, Heap &heap, const Word *arguments);
+
+struct Intrinsic {
+  std::string_view name;
+  Word arguments;
+  Function function;
+  // Functions that share data laid out in RAM, such as the blocks of the heap
+  // or the fields of a string, only work together with each other. Among the
+  // functions a program calls, either all or none of a group must be native.
+  // Empty for functions that stand on their own
+  std::string_view group;
+  // The group this one allocates from, if any, which then has to be native
+  // as well
+  std::string_view needs;
+};
+
+// Returns nullptr if there is no native implementation of name
+const Intrinsic *find(std::string_view name);
+const std::vector<Intrinsic> &all();
+
+} // namespace Intrinsics
@@ -1,5 +1,6 @@
 #include "vmcommand.h"
 
+#include <algorithm>
 #include <iostream>
 #include <climits>
 #include <sstream>
@@ -150,7 +151,12 @@ void VMCommand::print() const {
 }
 
 VMCommands::VMCommands() :
-  initializedExecution_(false)
+  memory_(nullptr),
+  numStatics_(0),
+  vmCommands_(),
+  nativeFunctions_(),
+  program_(),
+  context_()
 {
 
 }
@@ -158,7 +164,11 @@ VMCommands::VMCommands() :
 
 VMCommands::VMCommands(const std::string &inputFileName) :
   memory_(nullptr),
-  initializedExecution_(false)
+  numStatics_(0),
+  vmCommands_(),
+  nativeFunctions_(),
+  program_(),
+  context_()
 {
   if (!initialized_) throw std::runtime_error("Please call VMCommands::init before using VMCommands!");
 
@@ -308,239 +318,52 @@ std::size_t VMCommands::size() const {
 
 void VMCommands::setMemoryPtr(Word *ptr) {
   memory_ = ptr;
+  context_.reset();
 }
 
 void VMCommands::setKey(Word key) {
-  memory_[KBD] = key;
+  memory_[VMProgram::KBD] = key;
 }
 
-void VMCommands::initExecution() {
-  if (initializedExecution_) return;
-  initializedExecution_ = true;
-
-  for (std::size_t i = 0; i < 24577; ++i)
-    memory_[i] = 0;
-  memory_[SP] = memory_[LCL] = STACK;
-
-  std::unordered_map<std::string, std::size_t> functionTable;
-  std::unordered_map<std::string, std::size_t> labelTable;
-  for (std::size_t pos = 0; pos < vmCommands_.size(); ++pos) {
-    const auto &vmCommand = vmCommands_[pos];
-    if (vmCommand.op_ == VMCommand::Operation::FUNCTION) {
-      functionTable[vmCommand.str_] = pos;
-    } else if (vmCommand.op_ == VMCommand::Operation::LABEL) {
-      labelTable[vmCommand.str_] = pos;
-    }
-  }
-  for (auto &vmCommand : vmCommands_) {
-    if (vmCommand.op_ == VMCommand::Operation::CALL) {
-      auto it = functionTable.find(vmCommand.str_);
-      if (it == functionTable.end())
-        throw std::runtime_error("Function \"" + vmCommand.str_ + "\" is undefined");
-      vmCommand.label_ = static_cast<Word>(it->second);
-    } else if (vmCommand.op_ == VMCommand::Operation::GOTO || vmCommand.op_ == VMCommand::Operation::IF_GOTO) {
-      auto it = labelTable.find(vmCommand.str_);
-      if (it == labelTable.end())
-        throw std::runtime_error("Label \"" + vmCommand.str_ + "\" is undefined");
-      vmCommand.label_ = static_cast<Word>(it->second);
-    }
-  }
-
-  auto it = functionTable.find("Sys.init");
-  if (it == functionTable.end())
-    throw std::runtime_error("Cannot find entry point Sys.init");
-  startPos_ = curPos_ = it->second;
+void VMCommands::setNative(const std::string &function, bool native) {
+  if (Intrinsics::find(function) == nullptr)
+    throw std::runtime_error("Function \"" + function + "\" has no native implementation");
+  if (native)
+    nativeFunctions_.insert(function);
+  else
+    nativeFunctions_.erase(function);
+  program_.reset();
+  context_.reset();
 }
 
-bool VMCommands::execute(std::size_t steps) {
+void VMCommands::initExecution() {
   if (memory_ == nullptr)
     throw std::runtime_error("Please call VMCommands::setMemoryPtr before executing!");
-  if (!initializedExecution_)
-    throw std::runtime_error("Please call VMCommands::initExecution() before executing!");
+  if (!program_)
+    program_ = std::make_shared<const VMProgram>(*this, nativeFunctions_);
+  if (!context_)
+    context_.emplace(program_, memory_);
+}
 
-  std::size_t pos = curPos_;
-  for (std::size_t curStep = 0; curStep < steps; ++curStep) {
-    if (curPos_ >= vmCommands_.size())
-      throw std::runtime_error("Out of program memory");
-
-    const auto &vmCommand = vmCommands_[pos];
-
-    bool jump = false;
-    Word currentLCL;
-    std::size_t returnPos;
-    switch (vmCommand.op_) {
-      case VMCommand::Operation::ADD:
-        memory_[memory_[SP] - 2] =
-            static_cast<Word>(static_cast<int16_t>(
-                static_cast<int16_t>(memory_[memory_[SP] - 2]) +
-                static_cast<int16_t>(memory_[memory_[SP] - 1])));
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::SUB:
-        memory_[memory_[SP] - 2] =
-            static_cast<Word>(static_cast<int16_t>(
-                static_cast<int16_t>(memory_[memory_[SP] - 2]) -
-                static_cast<int16_t>(memory_[memory_[SP] - 1])));
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::NEG:
-        memory_[memory_[SP] - 1] = -memory_[memory_[SP] - 1];
-        break;
-      case VMCommand::Operation::EQ:
-        memory_[memory_[SP] - 2] = (memory_[memory_[SP] - 2] == memory_[memory_[SP] - 1]) ? (-1) : 0;
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::GT:
-        memory_[memory_[SP] - 2] = (memory_[memory_[SP] - 2] > memory_[memory_[SP] - 1]) ? (-1) : 0;
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::LT:
-        memory_[memory_[SP] - 2] = (memory_[memory_[SP] - 2] < memory_[memory_[SP] - 1]) ? (-1) : 0;
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::AND:
-        memory_[memory_[SP] - 2] = memory_[memory_[SP] - 2] & memory_[memory_[SP] - 1];
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::OR:
-        memory_[memory_[SP] - 2] = memory_[memory_[SP] - 2] | memory_[memory_[SP] - 1];
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::NOT:
-        memory_[memory_[SP] - 1] = ~memory_[memory_[SP] - 1];
-        break;
-      case VMCommand::Operation::POP:
-        pop_(vmCommand.segment_, vmCommand.n_);
-        break;
-      case VMCommand::Operation::PUSH:
-        push_(vmCommand.segment_, vmCommand.n_);
-        break;
-      case VMCommand::Operation::GOTO:
-        jump = true;
-        pos = static_cast<std::size_t>(vmCommand.label_);
-        break;
-      case VMCommand::Operation::IF_GOTO:
-        if (memory_[memory_[SP] - 1])
-          pos = static_cast<std::size_t>(vmCommand.label_);
-        --memory_[SP];
-        break;
-      case VMCommand::Operation::FUNCTION:
-        for (Word k = 0; k < vmCommand.n_; ++k)
-          push_(VMCommand::Segment::CONSTANT, 0);
-        break;
-      case VMCommand::Operation::CALL:
-        push_(VMCommand::Segment::CONSTANT, static_cast<Word>(pos + 1));
-        push_(VMCommand::Segment::CONSTANT, memory_[LCL]);
-        push_(VMCommand::Segment::CONSTANT, memory_[ARG]);
-        push_(VMCommand::Segment::CONSTANT, memory_[THIS]);
-        push_(VMCommand::Segment::CONSTANT, memory_[THAT]);
-        memory_[ARG] = memory_[SP] - vmCommand.n_ - 5;
-        memory_[LCL] = memory_[SP];
-
-        jump = true;
-        if (vmCommand.str_ == "Sys.halt") {
-          return true;
-        }
-        pos = static_cast<std::size_t>(vmCommand.label_);
-        break;
-      case VMCommand::Operation::RETURN:
-        currentLCL = memory_[LCL];
-        returnPos = static_cast<std::size_t>(memory_[currentLCL - 5]);
-        pop_(VMCommand::Segment::ARGUMENT, 0);
-        memory_[SP] = memory_[ARG] + 1;
-        memory_[THAT] = memory_[currentLCL - 1];
-        memory_[THIS] = memory_[currentLCL - 2];
-        memory_[ARG] = memory_[currentLCL - 3];
-        memory_[LCL] = memory_[currentLCL - 4];
-
-        jump = true;
-        pos = returnPos;
-        break;
-      default:
-        break;
-    }
-    if (!jump) ++pos;
-  }
+bool VMCommands::execute(std::size_t steps) {
+  if (!context_)
+    throw std::runtime_error("Please call VMCommands::initExecution() before executing!");
+  return context_->execute(steps);
+}
 
-  curPos_ = pos;
-  return false;
+std::shared_ptr<const VMProgram> VMCommands::program() const {
+  return program_;
 }
 
 void VMCommands::reset() {
-  curPos_ = startPos_;
-  for (std::size_t i = 0; i < 24577; ++i)
-    memory_[i] = 0;
-  memory_[SP] = memory_[LCL] = STACK;
+  if (context_) context_->reset();
 }
 
-Word VMCommands::numStatics_ = 0;
 void VMCommands::clear() {
-  initializedExecution_ = false;
   numStatics_ = 0;
   vmCommands_.clear();
-}
-
-void VMCommands::push_(VMCommand::Segment segment, Word offset) const {
-  switch (segment) {
-    case VMCommand::Segment::STATIC:
-      memory_[memory_[SP]] = memory_[STATIC + offset];
-      break;
-    case VMCommand::Segment::THIS:
-      memory_[memory_[SP]] = memory_[memory_[THIS] + offset];
-      break;
-    case VMCommand::Segment::LOCAL:
-      memory_[memory_[SP]] = memory_[memory_[LCL] + offset];
-      break;
-    case VMCommand::Segment::ARGUMENT:
-      memory_[memory_[SP]] = memory_[memory_[ARG] + offset];
-      break;
-    case VMCommand::Segment::THAT:
-      memory_[memory_[SP]] = memory_[memory_[THAT] + offset];
-      break;
-    case VMCommand::Segment::CONSTANT:
-      memory_[memory_[SP]] = offset;
-      break;
-    case VMCommand::Segment::POINTER:
-      memory_[memory_[SP]] = memory_[THIS + offset];
-      break;
-    case VMCommand::Segment::TEMP:
-      memory_[memory_[SP]] = memory_[TEMP + offset];
-      break;
-    default:
-      break;
-  }
-  ++memory_[SP];
-}
-
-void VMCommands::pop_(VMCommand::Segment segment, Word offset) const {
-  --memory_[SP];
-  switch (segment) {
-    case VMCommand::Segment::STATIC:
-      memory_[STATIC + offset] = memory_[memory_[SP]];
-      break;
-    case VMCommand::Segment::THIS:
-      memory_[memory_[THIS] + offset] = memory_[memory_[SP]];
-      break;
-    case VMCommand::Segment::LOCAL:
-      memory_[memory_[LCL] + offset] = memory_[memory_[SP]];
-      break;
-    case VMCommand::Segment::ARGUMENT:
-      memory_[memory_[ARG] + offset] = memory_[memory_[SP]];
-      break;
-    case VMCommand::Segment::CONSTANT:
-      throw std::runtime_error("Cannot pop into constant memory segment");
-    case VMCommand::Segment::THAT:
-      memory_[memory_[THAT] + offset] = memory_[memory_[SP]];
-      break;
-    case VMCommand::Segment::POINTER:
-      memory_[THIS + offset] = memory_[memory_[SP]];
-      break;
-    case VMCommand::Segment::TEMP:
-      memory_[TEMP + offset] = memory_[memory_[SP]];
-      break;
-    default:
-      break;
-  }
+  program_.reset();
+  context_.reset();
 }
 
 void VMCommands::toVMCode(std::iostream &outputFile) const {
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "vmprogram.h"
+
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <fstream>
 #include <unordered_map>
+#include <unordered_set>
 
 #define TO_SEGMENT_STRING(X) SEGMENT_STRINGS[static_cast<int>(X)]
 
@@ -70,12 +74,12 @@ public:
   void print() const;
 
   friend class VMCommands;
+  friend class VMProgram;
 
 private:
   Operation op_;
   Segment segment_;
   std::string str_;
-  Word label_;
   Word n_;
 };
 
@@ -106,8 +110,17 @@ public:
 
   void setMemoryPtr(Word *ptr);
   void setKey(Word key);
+  // Runs the named OS function with its native implementation from
+  // Intrinsics instead of interpreting its VM code. Takes effect at the next
+  // initExecution
+  void setNative(const std::string &function, bool native);
+  // Links the commands into a VMProgram and starts a VMContext for it on the
+  // memory set with setMemoryPtr
   void initExecution();
+  // Runs at most steps bytecodes of the program, see VMContext::execute
   bool execute(std::size_t steps);
+  // The program linked by initExecution, which more VMContexts can share
+  std::shared_ptr<const VMProgram> program() const;
 
   void reset();
   void clear();
@@ -116,22 +129,15 @@ public:
   std::string toVMCodeString() const;
 
 private:
-  void push_(VMCommand::Segment segment, Word offset) const;
-  void pop_(VMCommand::Segment segment, Word offset) const;
-
   static bool initialized_;
   static std::unordered_map<std::string, VMCommand::Operation> operations_;
   static std::unordered_map<std::string, VMCommand::Segment> segments_;
 
   Word *memory_;
-  // TODO: change segment offset
-  static constexpr Word SP = 0, LCL = 1, ARG = 2, THIS = 3, THAT = 4, TEMP = 5;
-  static constexpr Word STATIC = 16, STACK = 256, HEAP = 2048, KBD = 24576;
-
-  bool initializedExecution_;
-  static Word numStatics_;
-  std::size_t startPos_;
-  std::size_t curPos_;
+  Word numStatics_;
   std::vector<VMCommand> vmCommands_;
+  std::unordered_set<std::string> nativeFunctions_;
+  std::shared_ptr<const VMProgram> program_;
+  std::optional<VMContext> context_;
 };
 
@@ -0,0 +1,501 @@
+#include "vmprogram.h"
+
+#include "vmcommand.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace {
+
+// Superinstructions keep a second and a third operand in the halves of target
+std::uint32_t Pack(Word low, Word high) {
+  return static_cast<std::uint32_t>(static_cast<std::uint16_t>(low)) |
+      static_cast<std::uint32_t>(static_cast<std::uint16_t>(high)) << 16;
+}
+
+Word Low(std::uint32_t operands) {
+  return static_cast<Word>(operands & 0xffff);
+}
+
+Word High(std::uint32_t operands) {
+  return static_cast<Word>(operands >> 16);
+}
+
+} // namespace
+
+// Links the program by resolving every name in it, so that execution never
+// looks at a string: labels to positions in the bytecode, calls to special
+// functions to their opcodes and all other calls to entries of the function
+// table
+VMProgram::VMProgram(const VMCommands &vmCommands,
+                     const std::unordered_set<std::string> &nativeFunctions) :
+  startPos_(0),
+  bytecode_(),
+  functions_(),
+  natives_()
+{
+  // Labels emit no bytecode, so they refer to the position of whatever
+  // follows them
+  std::unordered_map<std::string, std::size_t> functionTable;
+  std::unordered_map<std::string, std::size_t> labelTable;
+  // The smallest number of arguments each function can be called with, given
+  // the arguments it uses
+  std::vector<Word> usedArguments;
+  // The last command each bytecode stands for, which is the one a jump or a
+  // call in it comes from
+  std::vector<std::size_t> sources;
+  for (std::size_t pos = 0; pos < vmCommands.size();) {
+    const auto &vmCommand = vmCommands[pos];
+    if (vmCommand.op_ == VMCommand::Operation::FUNCTION) {
+      if (!functionTable.emplace(vmCommand.str_, functions_.size()).second)
+        throw std::runtime_error("Function \"" + vmCommand.str_ + "\" is defined more than once");
+      functions_.push_back({static_cast<std::uint32_t>(bytecode_.size()), vmCommand.n_, -1});
+      usedArguments.push_back(0);
+    } else if (vmCommand.op_ == VMCommand::Operation::LABEL) {
+      labelTable[vmCommand.str_] = bytecode_.size();
+      ++pos;
+      continue;
+    }
+
+    Bytecode bytecode;
+    std::size_t length = fuse_(vmCommands, pos, bytecode);
+    if (length == 0) {
+      bytecode = lower_(vmCommand);
+      length = 1;
+    }
+    for (std::size_t i = pos; i < pos + length; ++i) {
+      const auto &command = vmCommands[i];
+      if ((command.op_ == VMCommand::Operation::PUSH || command.op_ == VMCommand::Operation::POP) &&
+          command.segment_ == VMCommand::Segment::ARGUMENT && !usedArguments.empty())
+        usedArguments.back() = std::max(usedArguments.back(), static_cast<Word>(command.n_ + 1));
+    }
+    bytecode_.push_back(bytecode);
+    pos += length;
+    sources.push_back(pos - 1);
+  }
+
+  // Whether the functions of each group of intrinsics that the program calls
+  // are native or interpreted, with one of them to blame
+  std::unordered_map<std::string_view, std::pair<bool, std::string>> groups;
+  auto checkGroup = [&groups](std::string_view group, bool native, const std::string &name) {
+    auto it = groups.emplace(group, std::make_pair(native, name)).first;
+    if (it->second.first != native) {
+      const std::string &nativeName = native ? name : it->second.second;
+      const std::string &interpretedName = native ? it->second.second : name;
+      throw std::runtime_error("Function \"" + interpretedName + "\" must be native, as \"" +
+          nativeName + "\" is");
+    }
+  };
+  std::unordered_map<std::string, std::size_t> nativeTable;
+
+  for (std::size_t pos = 0; pos < bytecode_.size(); ++pos) {
+    const auto &vmCommand = vmCommands[sources[pos]];
+    Bytecode &bytecode = bytecode_[pos];
+    if (vmCommand.op_ == VMCommand::Operation::CALL) {
+      const std::string &name = vmCommand.str_;
+      const std::string arguments = std::to_string(vmCommand.n_) + " arguments";
+      auto special = std::find_if(
+          std::begin(SPECIAL_FUNCTIONS), std::end(SPECIAL_FUNCTIONS),
+          [&name](const SpecialFunction &function) { return name == function.name; });
+      if (special != std::end(SPECIAL_FUNCTIONS)) {
+        if (vmCommand.n_ != special->arguments)
+          throw std::runtime_error("Function \"" + name + "\" takes " +
+              std::to_string(special->arguments) + " arguments but is called with " + arguments);
+        bytecode.op = special->op;
+      } else if (nativeFunctions.count(name)) {
+        const Intrinsics::Intrinsic &intrinsic = *Intrinsics::find(name);
+        if (vmCommand.n_ != intrinsic.arguments)
+          throw std::runtime_error("Function \"" + name + "\" takes " +
+              std::to_string(intrinsic.arguments) + " arguments but is called with " + arguments);
+        if (!intrinsic.group.empty()) checkGroup(intrinsic.group, true, name);
+        if (!intrinsic.needs.empty()) checkGroup(intrinsic.needs, true, name);
+        auto it = nativeTable.emplace(name, natives_.size()).first;
+        if (it->second == natives_.size()) natives_.push_back(intrinsic.function);
+        bytecode.op = Opcode::NATIVE;
+        bytecode.target = static_cast<std::uint32_t>(it->second);
+      } else {
+        const Intrinsics::Intrinsic *intrinsic = Intrinsics::find(name);
+        if (intrinsic != nullptr && !intrinsic->group.empty())
+          checkGroup(intrinsic->group, false, name);
+        auto it = functionTable.find(name);
+        if (it == functionTable.end())
+          throw std::runtime_error("Function \"" + name + "\" is undefined");
+        Function &function = functions_[it->second];
+        if (vmCommand.n_ < usedArguments[it->second])
+          throw std::runtime_error("Function \"" + name + "\" uses argument " +
+              std::to_string(usedArguments[it->second] - 1) + " but is called with " + arguments);
+        if (function.arguments != -1 && function.arguments != vmCommand.n_)
+          throw std::runtime_error("Function \"" + name + "\" is called with both " +
+              std::to_string(function.arguments) + " and " + arguments);
+        function.arguments = vmCommand.n_;
+        bytecode.target = static_cast<std::uint32_t>(it->second);
+      }
+    } else if (vmCommand.op_ == VMCommand::Operation::GOTO || vmCommand.op_ == VMCommand::Operation::IF_GOTO) {
+      auto it = labelTable.find(vmCommand.str_);
+      if (it == labelTable.end())
+        throw std::runtime_error("Label \"" + vmCommand.str_ + "\" is undefined");
+      bytecode.target = static_cast<std::uint32_t>(it->second);
+    }
+  }
+  bytecode_.push_back({Opcode::END, 0, 0});
+  if (bytecode_.size() > MAX_BYTECODES)
+    throw std::runtime_error("Program is too large: " + std::to_string(bytecode_.size()) +
+        " bytecodes, at most " + std::to_string(MAX_BYTECODES) + " fit");
+
+  auto it = functionTable.find("Sys.init");
+  if (it == functionTable.end())
+    throw std::runtime_error("Cannot find entry point Sys.init");
+  startPos_ = functions_[it->second].pos;
+}
+
+VMProgram::Bytecode VMProgram::lower_(const VMCommand &vmCommand) {
+  static constexpr Opcode ARITHMETIC[] = {
+    Opcode::ADD, Opcode::SUB, Opcode::NEG, Opcode::EQ, Opcode::GT,
+    Opcode::LT, Opcode::AND, Opcode::OR, Opcode::NOT
+  };
+
+  Word n = vmCommand.n_;
+  switch (vmCommand.op_) {
+    case VMCommand::Operation::PUSH:
+    case VMCommand::Operation::POP: {
+      bool push = vmCommand.op_ == VMCommand::Operation::PUSH;
+      switch (vmCommand.segment_) {
+        case VMCommand::Segment::CONSTANT:
+          if (!push)
+            throw std::runtime_error("Cannot pop into constant memory segment");
+          return {Opcode::PUSH_CONSTANT, n, 0};
+        case VMCommand::Segment::STATIC:
+          return {push ? Opcode::PUSH_ADDRESS : Opcode::POP_ADDRESS, static_cast<Word>(STATIC + n), 0};
+        case VMCommand::Segment::POINTER:
+          return {push ? Opcode::PUSH_ADDRESS : Opcode::POP_ADDRESS, static_cast<Word>(THIS + n), 0};
+        case VMCommand::Segment::TEMP:
+          return {push ? Opcode::PUSH_ADDRESS : Opcode::POP_ADDRESS, static_cast<Word>(TEMP + n), 0};
+        case VMCommand::Segment::LOCAL:
+          return {push ? Opcode::PUSH_LOCAL : Opcode::POP_LOCAL, n, 0};
+        case VMCommand::Segment::ARGUMENT:
+          return {push ? Opcode::PUSH_ARGUMENT : Opcode::POP_ARGUMENT, n, 0};
+        case VMCommand::Segment::THIS:
+          return {push ? Opcode::PUSH_THIS : Opcode::POP_THIS, n, 0};
+        case VMCommand::Segment::THAT:
+          return {push ? Opcode::PUSH_THAT : Opcode::POP_THAT, n, 0};
+      }
+      break;
+    }
+    case VMCommand::Operation::GOTO:
+      return {Opcode::GOTO, 0, 0};
+    case VMCommand::Operation::IF_GOTO:
+      return {Opcode::IF_GOTO, 0, 0};
+    case VMCommand::Operation::FUNCTION:
+      return {Opcode::FUNCTION, n, 0};
+    case VMCommand::Operation::CALL:
+      return {Opcode::CALL, n, 0};
+    case VMCommand::Operation::RETURN:
+      return {Opcode::RETURN, 0, 0};
+    case VMCommand::Operation::LABEL:
+      break;
+    default:
+      return {ARITHMETIC[static_cast<int>(vmCommand.op_)], 0, 0};
+  }
+  throw std::runtime_error("Cannot lower VM command");
+}
+
+// Looks for a superinstruction that stands for the commands from pos on and
+// returns how many of them it replaces, or 0 if there is none. The commands
+// of a superinstruction never include a label, and only the last one may
+// jump, so the link step resolves it like that command
+std::size_t VMProgram::fuse_(const VMCommands &vmCommands, std::size_t pos, Bytecode &bytecode) {
+  using Operation = VMCommand::Operation;
+  using Segment = VMCommand::Segment;
+  auto is = [&vmCommands, pos](std::size_t k, Operation op) {
+    return pos + k < vmCommands.size() && vmCommands[pos + k].op_ == op;
+  };
+  auto isAccess = [&vmCommands, pos, &is](std::size_t k, Operation op, Segment segment) {
+    return is(k, op) && vmCommands[pos + k].segment_ == segment;
+  };
+  auto n = [&vmCommands, pos](std::size_t k) {
+    return vmCommands[pos + k].n_;
+  };
+
+  if (isAccess(0, Operation::PUSH, Segment::LOCAL) && isAccess(1, Operation::PUSH, Segment::CONSTANT) &&
+      is(2, Operation::ADD) && isAccess(3, Operation::POP, Segment::LOCAL)) {
+    bytecode = {Opcode::LOCAL_PLUS_CONSTANT, n(0), Pack(n(1), n(3))};
+    return 4;
+  }
+  if (is(0, Operation::ADD) && isAccess(1, Operation::POP, Segment::POINTER) && n(1) == 1) {
+    if (isAccess(2, Operation::PUSH, Segment::THAT)) {
+      bytecode = {Opcode::READ_ARRAY, n(2), 0};
+      return 3;
+    }
+    if (isAccess(2, Operation::POP, Segment::THAT)) {
+      bytecode = {Opcode::WRITE_ARRAY, n(2), 0};
+      return 3;
+    }
+  }
+  if (isAccess(0, Operation::PUSH, Segment::LOCAL)) {
+    if (isAccess(1, Operation::PUSH, Segment::LOCAL)) {
+      bytecode = {Opcode::PUSH_LOCAL_LOCAL, n(0), Pack(n(1), 0)};
+      return 2;
+    }
+    if (isAccess(1, Operation::PUSH, Segment::CONSTANT)) {
+      bytecode = {Opcode::PUSH_LOCAL_CONSTANT, n(0), Pack(n(1), 0)};
+      return 2;
+    }
+    if (is(1, Operation::ADD)) {
+      bytecode = {Opcode::ADD_LOCAL, n(0), 0};
+      return 2;
+    }
+  }
+  if (isAccess(0, Operation::PUSH, Segment::CONSTANT)) {
+    if (isAccess(1, Operation::POP, Segment::LOCAL)) {
+      bytecode = {Opcode::SET_LOCAL, n(1), Pack(n(0), 0)};
+      return 2;
+    }
+    if (is(1, Operation::ADD)) {
+      bytecode = {Opcode::ADD_CONSTANT, n(0), 0};
+      return 2;
+    }
+  }
+  if (is(0, Operation::ADD) && isAccess(1, Operation::POP, Segment::LOCAL)) {
+    bytecode = {Opcode::ADD_POP_LOCAL, n(1), 0};
+    return 2;
+  }
+  if (is(1, Operation::IF_GOTO)) {
+    if (is(0, Operation::LT)) {
+      bytecode = {Opcode::IF_LT, 0, 0};
+      return 2;
+    }
+    if (is(0, Operation::GT)) {
+      bytecode = {Opcode::IF_GT, 0, 0};
+      return 2;
+    }
+    if (is(0, Operation::EQ)) {
+      bytecode = {Opcode::IF_EQ, 0, 0};
+      return 2;
+    }
+  }
+  return 0;
+}
+
+VMContext::VMContext(std::shared_ptr<const VMProgram> program, Word *memory) :
+  program_(std::move(program)),
+  memory_(memory),
+  curPos_(0),
+  heap_()
+{
+  if (memory_ == nullptr)
+    throw std::runtime_error("A VM context needs memory to run on");
+  reset();
+}
+
+void VMContext::setKey(Word key) {
+  memory_[VMProgram::KBD] = key;
+}
+
+bool VMContext::execute(std::size_t steps) {
+  using Opcode = VMProgram::Opcode;
+  using Bytecode = VMProgram::Bytecode;
+  using Function = VMProgram::Function;
+
+  Word *memory = memory_;
+  const Bytecode *bytecode = program_->bytecode_.data();
+  const Function *functions = program_->functions_.data();
+  const Intrinsics::Function *natives = program_->natives_.data();
+  std::size_t size = program_->bytecode_.size();
+  std::size_t pos = curPos_;
+  for (std::size_t curStep = 0; curStep < steps; ++curStep) {
+    const Bytecode &command = bytecode[pos++];
+    Word &sp = memory[VMProgram::SP];
+    Word currentLCL;
+    switch (command.op) {
+      case Opcode::ADD:
+        --sp;
+        memory[sp - 1] = static_cast<Word>(memory[sp - 1] + memory[sp]);
+        break;
+      case Opcode::SUB:
+        --sp;
+        memory[sp - 1] = static_cast<Word>(memory[sp - 1] - memory[sp]);
+        break;
+      case Opcode::NEG:
+        memory[sp - 1] = static_cast<Word>(-memory[sp - 1]);
+        break;
+      case Opcode::EQ:
+        --sp;
+        memory[sp - 1] = (memory[sp - 1] == memory[sp]) ? (-1) : 0;
+        break;
+      case Opcode::GT:
+        --sp;
+        memory[sp - 1] = (memory[sp - 1] > memory[sp]) ? (-1) : 0;
+        break;
+      case Opcode::LT:
+        --sp;
+        memory[sp - 1] = (memory[sp - 1] < memory[sp]) ? (-1) : 0;
+        break;
+      case Opcode::AND:
+        --sp;
+        memory[sp - 1] = memory[sp - 1] & memory[sp];
+        break;
+      case Opcode::OR:
+        --sp;
+        memory[sp - 1] = memory[sp - 1] | memory[sp];
+        break;
+      case Opcode::NOT:
+        memory[sp - 1] = static_cast<Word>(~memory[sp - 1]);
+        break;
+      case Opcode::PUSH_CONSTANT:
+        memory[sp++] = command.n;
+        break;
+      case Opcode::PUSH_ADDRESS:
+        memory[sp++] = memory[command.n];
+        break;
+      case Opcode::PUSH_LOCAL:
+        memory[sp++] = memory[memory[VMProgram::LCL] + command.n];
+        break;
+      case Opcode::PUSH_ARGUMENT:
+        memory[sp++] = memory[memory[VMProgram::ARG] + command.n];
+        break;
+      case Opcode::PUSH_THIS:
+        memory[sp++] = memory[memory[VMProgram::THIS] + command.n];
+        break;
+      case Opcode::PUSH_THAT:
+        memory[sp++] = memory[memory[VMProgram::THAT] + command.n];
+        break;
+      case Opcode::POP_ADDRESS:
+        memory[command.n] = memory[--sp];
+        break;
+      case Opcode::POP_LOCAL:
+        --sp;
+        memory[memory[VMProgram::LCL] + command.n] = memory[sp];
+        break;
+      case Opcode::POP_ARGUMENT:
+        --sp;
+        memory[memory[VMProgram::ARG] + command.n] = memory[sp];
+        break;
+      case Opcode::POP_THIS:
+        --sp;
+        memory[memory[VMProgram::THIS] + command.n] = memory[sp];
+        break;
+      case Opcode::POP_THAT:
+        --sp;
+        memory[memory[VMProgram::THAT] + command.n] = memory[sp];
+        break;
+      case Opcode::GOTO:
+        pos = command.target;
+        break;
+      case Opcode::IF_GOTO:
+        if (memory[--sp])
+          pos = command.target;
+        break;
+      case Opcode::FUNCTION:
+        for (Word k = 0; k < command.n; ++k)
+          memory[sp++] = 0;
+        break;
+      case Opcode::CALL: {
+        const Function &function = functions[command.target];
+        memory[sp] = static_cast<Word>(pos);
+        memory[sp + 1] = memory[VMProgram::LCL];
+        memory[sp + 2] = memory[VMProgram::ARG];
+        memory[sp + 3] = memory[VMProgram::THIS];
+        memory[sp + 4] = memory[VMProgram::THAT];
+        sp = static_cast<Word>(sp + 5);
+        memory[VMProgram::ARG] = static_cast<Word>(sp - command.n - 5);
+        memory[VMProgram::LCL] = sp;
+
+        // Does the work of the function command as well, which is skipped
+        for (Word k = 0; k < function.locals; ++k)
+          memory[sp++] = 0;
+        pos = function.pos + 1;
+        break;
+      }
+      case Opcode::RETURN:
+        currentLCL = memory[VMProgram::LCL];
+        pos = static_cast<std::uint16_t>(memory[currentLCL - 5]);
+        memory[memory[VMProgram::ARG]] = memory[sp - 1];
+        sp = static_cast<Word>(memory[VMProgram::ARG] + 1);
+        memory[VMProgram::THAT] = memory[currentLCL - 1];
+        memory[VMProgram::THIS] = memory[currentLCL - 2];
+        memory[VMProgram::ARG] = memory[currentLCL - 3];
+        memory[VMProgram::LCL] = memory[currentLCL - 4];
+        if (pos >= size) {
+          curPos_ = size - 1;
+          throw std::runtime_error("Out of program memory");
+        }
+        break;
+      case Opcode::NATIVE:
+        sp = static_cast<Word>(sp - command.n);
+        memory[sp] = natives[command.target](memory, heap_, memory + sp);
+        ++sp;
+        break;
+      case Opcode::LOCAL_PLUS_CONSTANT:
+        memory[memory[VMProgram::LCL] + High(command.target)] =
+            static_cast<Word>(memory[memory[VMProgram::LCL] + command.n] + Low(command.target));
+        break;
+      case Opcode::READ_ARRAY:
+        --sp;
+        memory[VMProgram::THAT] = static_cast<Word>(memory[sp - 1] + memory[sp]);
+        memory[sp - 1] = memory[memory[VMProgram::THAT] + command.n];
+        break;
+      case Opcode::WRITE_ARRAY:
+        sp = static_cast<Word>(sp - 3);
+        memory[VMProgram::THAT] = static_cast<Word>(memory[sp + 1] + memory[sp + 2]);
+        memory[memory[VMProgram::THAT] + command.n] = memory[sp];
+        break;
+      case Opcode::PUSH_LOCAL_LOCAL:
+        memory[sp] = memory[memory[VMProgram::LCL] + command.n];
+        memory[sp + 1] = memory[memory[VMProgram::LCL] + Low(command.target)];
+        sp = static_cast<Word>(sp + 2);
+        break;
+      case Opcode::PUSH_LOCAL_CONSTANT:
+        memory[sp] = memory[memory[VMProgram::LCL] + command.n];
+        memory[sp + 1] = Low(command.target);
+        sp = static_cast<Word>(sp + 2);
+        break;
+      case Opcode::SET_LOCAL:
+        memory[memory[VMProgram::LCL] + command.n] = Low(command.target);
+        break;
+      case Opcode::ADD_LOCAL:
+        memory[sp - 1] = static_cast<Word>(memory[sp - 1] + memory[memory[VMProgram::LCL] + command.n]);
+        break;
+      case Opcode::ADD_CONSTANT:
+        memory[sp - 1] = static_cast<Word>(memory[sp - 1] + command.n);
+        break;
+      case Opcode::ADD_POP_LOCAL:
+        sp = static_cast<Word>(sp - 2);
+        memory[memory[VMProgram::LCL] + command.n] = static_cast<Word>(memory[sp] + memory[sp + 1]);
+        break;
+      case Opcode::IF_LT:
+        sp = static_cast<Word>(sp - 2);
+        if (memory[sp] < memory[sp + 1])
+          pos = command.target;
+        break;
+      case Opcode::IF_GT:
+        sp = static_cast<Word>(sp - 2);
+        if (memory[sp] > memory[sp + 1])
+          pos = command.target;
+        break;
+      case Opcode::IF_EQ:
+        sp = static_cast<Word>(sp - 2);
+        if (memory[sp] == memory[sp + 1])
+          pos = command.target;
+        break;
+      case Opcode::HALT:
+        curPos_ = pos - 1;
+        return true;
+      case Opcode::END:
+        curPos_ = pos - 1;
+        throw std::runtime_error("Out of program memory");
+    }
+  }
+
+  curPos_ = pos;
+  return false;
+}
+
+void VMContext::reset() {
+  curPos_ = program_->startPos_;
+  heap_.reset();
+  for (std::size_t i = 0; i < 24577; ++i)
+    memory_[i] = 0;
+  memory_[VMProgram::SP] = memory_[VMProgram::LCL] = VMProgram::STACK;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "intrinsics.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class VMCommand;
+class VMCommands;
+
+// VM commands linked into bytecode, ready to be interpreted. A program is
+// never changed once it is built, so any number of VMContexts can run it at
+// the same time, on any threads
+class VMProgram {
+public:
+  // Where the VM keeps its pointers and segments in RAM
+  // TODO: change segment offset
+  static constexpr Word SP = 0, LCL = 1, ARG = 2, THIS = 3, THAT = 4, TEMP = 5;
+  static constexpr Word STATIC = 16, STACK = 256, HEAP = 2048, KBD = 24576;
+
+  // Links the commands into a program that starts at Sys.init. The functions
+  // in nativeFunctions run with their native implementation from Intrinsics
+  // instead of their VM code
+  explicit VMProgram(const VMCommands &vmCommands,
+                     const std::unordered_set<std::string> &nativeFunctions = {});
+
+  friend class VMContext;
+
+private:
+  // What the commands are lowered to. Segments are folded into the opcode,
+  // and static, pointer and temp accesses become absolute addresses
+  enum class Opcode : std::uint8_t {
+    ADD,
+    SUB,
+    NEG,
+    EQ,
+    GT,
+    LT,
+    AND,
+    OR,
+    NOT,
+    PUSH_CONSTANT,
+    PUSH_ADDRESS,
+    PUSH_LOCAL,
+    PUSH_ARGUMENT,
+    PUSH_THIS,
+    PUSH_THAT,
+    POP_ADDRESS,
+    POP_LOCAL,
+    POP_ARGUMENT,
+    POP_THIS,
+    POP_THAT,
+    GOTO,
+    IF_GOTO,
+    FUNCTION,
+    CALL,
+    RETURN,
+    HALT,
+    NATIVE,
+    // Superinstructions, each standing for one of the sequences the compiler
+    // emits the most, as counted by HackVmPatterns. Their operands are in n
+    // and in the halves of target
+    LOCAL_PLUS_CONSTANT,  // push local a; push constant c; add; pop local b
+    READ_ARRAY,           // add; pop pointer 1; push that n
+    WRITE_ARRAY,          // add; pop pointer 1; pop that n
+    PUSH_LOCAL_LOCAL,     // push local a; push local b
+    PUSH_LOCAL_CONSTANT,  // push local a; push constant c
+    SET_LOCAL,            // push constant c; pop local a
+    ADD_LOCAL,            // push local a; add
+    ADD_CONSTANT,         // push constant c; add
+    ADD_POP_LOCAL,        // add; pop local a
+    IF_LT,                // lt; if-goto
+    IF_GT,                // gt; if-goto
+    IF_EQ,                // eq; if-goto
+    // Placed after the last command, so that running off the end of the
+    // program needs no check of its own
+    END
+  };
+
+  // A command with its operands resolved: labels are dropped, jumps refer to
+  // the position of their target in the bytecode and calls to their entry in
+  // the function table
+  struct Bytecode {
+    Opcode op;
+    Word n;
+    std::uint32_t target;
+  };
+  static_assert(sizeof(Bytecode) == 8, "Bytecode should fit into 8 bytes");
+  // Calls keep their return position in a word of RAM
+  static constexpr std::size_t MAX_BYTECODES = 1 << 16;
+
+  struct Function {
+    std::uint32_t pos;
+    Word locals;
+    // The number of arguments every call passes, -1 until the first call
+    Word arguments;
+  };
+
+  // Functions the interpreter implements itself. Calls to them are linked to
+  // their opcode, whether or not the program defines them
+  struct SpecialFunction {
+    const char *name;
+    Word arguments;
+    Opcode op;
+  };
+  static constexpr SpecialFunction SPECIAL_FUNCTIONS[] = {
+    {"Sys.halt", 0, Opcode::HALT}
+  };
+
+  static std::size_t fuse_(const VMCommands &vmCommands, std::size_t pos, Bytecode &bytecode);
+  static Bytecode lower_(const VMCommand &vmCommand);
+
+  std::size_t startPos_;
+  std::vector<Bytecode> bytecode_;
+  std::vector<Function> functions_;
+  std::vector<Intrinsics::Function> natives_;
+};
+
+// One run of a VMProgram: the memory it runs on, where it is and the native
+// heap, if it uses one
+class VMContext {
+public:
+  // memory has to hold the 24577 words of RAM and outlive the context, which
+  // starts out reset
+  VMContext(std::shared_ptr<const VMProgram> program, Word *memory);
+  // A copy would run on the same memory as the original, so every run needs
+  // a context of its own
+  VMContext(const VMContext &) = delete;
+  VMContext& operator=(const VMContext &) = delete;
+  VMContext(VMContext &&) = default;
+  VMContext& operator=(VMContext &&) = default;
+
+  void setKey(Word key);
+  // Runs at most steps bytecodes and returns whether the program halted. A
+  // bytecode may be several fused VM commands and labels take none, so steps
+  // does not bound the number of VM commands run
+  bool execute(std::size_t steps);
+  void reset();
+
+private:
+  std::shared_ptr<const VMProgram> program_;
+  Word *memory_;
+  std::size_t curPos_;
+  Intrinsics::Heap heap_;
+};
@@ -0,0 +1,233 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <numeric>
+
+BatchCpu::BatchCpu(std::size_t lanes) :
+  numLanes_(lanes),
+  microProgram_(ROM_SIZE, Decode(0)),
+  pc_(lanes, 0),
+  registerA_(lanes, 0),
+  registerD_(lanes, 0),
+  memory_((std::size_t{1} << WORD_WIDTH) * lanes, 0),
+  laneOrder_(lanes),
+  groups_(),
+  results_(lanes, 0),
+  groupOfPc_(std::size_t{1} << WORD_WIDTH, -1),
+  nextLaneOrder_(lanes),
+  nextGroups_()
+{
+  reset();
+}
+
+void BatchCpu::load(const Word *program) {
+  for (std::size_t i = 0; i < ROM_SIZE; ++i)
+    microProgram_[i] = Decode(program[i]);
+}
+
+void BatchCpu::reset() {
+  std::fill(pc_.begin(), pc_.end(), 0);
+  std::fill(registerA_.begin(), registerA_.end(), 0);
+  std::fill(registerD_.begin(), registerD_.end(), 0);
+  std::fill(memory_.begin(), memory_.end(), 0);
+  std::iota(laneOrder_.begin(), laneOrder_.end(), 0);
+  groups_.clear();
+  if (numLanes_ > 0) groups_.push_back({0, 0, numLanes_});
+}
+
+void BatchCpu::setKey(std::size_t lane, Word key) {
+  memory_[KBD * numLanes_ + lane] = key;
+}
+
+void BatchCpu::execute(std::size_t steps) {
+  for (std::size_t step = 0; step < steps; ++step) {
+    if (groups_.size() == 1) {
+      // Every lane is in the group, so its positions can be the lanes
+      // themselves, which keeps all the register accesses contiguous
+      if (executeGroup(groups_[0], [](std::size_t i) { return i; }))
+        regroup();
+      continue;
+    }
+
+    // Groups only have to be rebuilt when one splits or two reach the same pc
+    bool changed = false;
+    for (auto &group : groups_) {
+      const std::size_t *lanes = laneOrder_.data() + group.begin;
+      if (executeGroup(group, [lanes](std::size_t i) { return lanes[i]; }))
+        changed = true;
+      auto &mark = groupOfPc_[static_cast<std::uint16_t>(group.pc)];
+      if (mark >= 0) changed = true;
+      mark = 0;
+    }
+    for (const auto &group : groups_)
+      groupOfPc_[static_cast<std::uint16_t>(group.pc)] = -1;
+    if (changed) regroup();
+  }
+}
+
+std::size_t BatchCpu::lanes() const {
+  return numLanes_;
+}
+
+std::size_t BatchCpu::groups() const {
+  return groups_.size();
+}
+
+Word BatchCpu::pc(std::size_t lane) const {
+  return pc_[lane];
+}
+
+Word BatchCpu::registerA(std::size_t lane) const {
+  return registerA_[lane];
+}
+
+Word BatchCpu::registerD(std::size_t lane) const {
+  return registerD_[lane];
+}
+
+Word BatchCpu::memory(std::size_t lane, std::uint16_t address) const {
+  return memory_[address * numLanes_ + lane];
+}
+
+// Same semantics as ExecuteC, one stage at a time over all the lanes of the
+// group: M is read and written at the old A, and the jump goes to the new A
+template <typename LaneOf>
+bool BatchCpu::executeGroup(Group &group, LaneOf laneOf) {
+  const MicroOp &op = microProgram_[static_cast<std::size_t>(group.pc)];
+  std::size_t count = group.end - group.begin;
+  Word *pc = pc_.data(), *a = registerA_.data(), *d = registerD_.data();
+  Word *memory = memory_.data();
+  std::size_t numLanes = numLanes_;
+  auto next = static_cast<Word>(group.pc + 1);
+  group.pc = next;
+  if (op.alu == AluFunction::LOAD_A) {
+    for (std::size_t i = 0; i < count; ++i) {
+      a[laneOf(i)] = op.instruction;
+      pc[laneOf(i)] = next;
+    }
+    return false;
+  }
+
+  switch (op.alu) {
+    case AluFunction::ZERO:
+      computeGroup<AluFunction::ZERO>(op, count, laneOf); break;
+    case AluFunction::ONE:
+      computeGroup<AluFunction::ONE>(op, count, laneOf); break;
+    case AluFunction::MINUS_ONE:
+      computeGroup<AluFunction::MINUS_ONE>(op, count, laneOf); break;
+    case AluFunction::X:
+      computeGroup<AluFunction::X>(op, count, laneOf); break;
+    case AluFunction::Y:
+      computeGroup<AluFunction::Y>(op, count, laneOf); break;
+    case AluFunction::NOT_X:
+      computeGroup<AluFunction::NOT_X>(op, count, laneOf); break;
+    case AluFunction::NOT_Y:
+      computeGroup<AluFunction::NOT_Y>(op, count, laneOf); break;
+    case AluFunction::NEGATE_X:
+      computeGroup<AluFunction::NEGATE_X>(op, count, laneOf); break;
+    case AluFunction::NEGATE_Y:
+      computeGroup<AluFunction::NEGATE_Y>(op, count, laneOf); break;
+    case AluFunction::X_PLUS_ONE:
+      computeGroup<AluFunction::X_PLUS_ONE>(op, count, laneOf); break;
+    case AluFunction::Y_PLUS_ONE:
+      computeGroup<AluFunction::Y_PLUS_ONE>(op, count, laneOf); break;
+    case AluFunction::X_MINUS_ONE:
+      computeGroup<AluFunction::X_MINUS_ONE>(op, count, laneOf); break;
+    case AluFunction::Y_MINUS_ONE:
+      computeGroup<AluFunction::Y_MINUS_ONE>(op, count, laneOf); break;
+    case AluFunction::X_PLUS_Y:
+      computeGroup<AluFunction::X_PLUS_Y>(op, count, laneOf); break;
+    case AluFunction::X_MINUS_Y:
+      computeGroup<AluFunction::X_MINUS_Y>(op, count, laneOf); break;
+    case AluFunction::Y_MINUS_X:
+      computeGroup<AluFunction::Y_MINUS_X>(op, count, laneOf); break;
+    case AluFunction::X_AND_Y:
+      computeGroup<AluFunction::X_AND_Y>(op, count, laneOf); break;
+    case AluFunction::X_OR_Y:
+      computeGroup<AluFunction::X_OR_Y>(op, count, laneOf); break;
+    default:
+      computeGroup<AluFunction::GENERIC>(op, count, laneOf); break;
+  }
+
+  const Word *results = results_.data();
+  if (op.dest & DEST_MASK_M) {
+    for (std::size_t i = 0; i < count; ++i) {
+      std::size_t lane = laneOf(i);
+      memory[static_cast<std::uint16_t>(a[lane]) * numLanes + lane] =
+          results[i];
+    }
+  }
+  if (op.dest & DEST_MASK_A) {
+    for (std::size_t i = 0; i < count; ++i) a[laneOf(i)] = results[i];
+  }
+  if (op.dest & DEST_MASK_D) {
+    for (std::size_t i = 0; i < count; ++i) d[laneOf(i)] = results[i];
+  }
+
+  if (!op.jump) {
+    for (std::size_t i = 0; i < count; ++i) pc[laneOf(i)] = next;
+    return false;
+  }
+  bool diverged = false;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t lane = laneOf(i);
+    pc[lane] = (op.jump & JumpCondition(results[i])) ? a[lane] : next;
+  }
+  group.pc = pc[laneOf(0)];
+  for (std::size_t i = 1; i < count; ++i)
+    diverged |= pc[laneOf(i)] != group.pc;
+  return diverged;
+}
+
+template <AluFunction ALU, typename LaneOf>
+void BatchCpu::computeGroup(const MicroOp &op, std::size_t count,
+                            LaneOf laneOf) {
+  const Word *a = registerA_.data(), *d = registerD_.data();
+  const Word *memory = memory_.data();
+  std::size_t numLanes = numLanes_;
+  Word *results = results_.data();
+  // With the ALU function fixed, these loops have no branches left
+  if (op.useM) {
+    for (std::size_t i = 0; i < count; ++i) {
+      std::size_t lane = laneOf(i);
+      Word y = memory[static_cast<std::uint16_t>(a[lane]) * numLanes + lane];
+      results[i] = Compute(ALU, op.instruction, d[lane], y);
+    }
+  } else {
+    for (std::size_t i = 0; i < count; ++i) {
+      std::size_t lane = laneOf(i);
+      results[i] = Compute(ALU, op.instruction, d[lane], a[lane]);
+    }
+  }
+}
+
+// Sorts laneOrder_ into one group per distinct pc, keeping the order of the
+// lanes within each group
+void BatchCpu::regroup() {
+  nextGroups_.clear();
+  for (std::size_t lane : laneOrder_) {
+    auto pc = static_cast<std::uint16_t>(pc_[lane]);
+    if (groupOfPc_[pc] < 0) {
+      groupOfPc_[pc] = static_cast<std::int32_t>(nextGroups_.size());
+      nextGroups_.push_back({pc_[lane], 0, 0});
+    }
+    ++nextGroups_[static_cast<std::size_t>(groupOfPc_[pc])].end;
+  }
+
+  std::size_t begin = 0;
+  for (auto &group : nextGroups_) {
+    std::size_t count = group.end;
+    group.begin = group.end = begin;
+    begin += count;
+  }
+  for (std::size_t lane : laneOrder_) {
+    auto pc = static_cast<std::uint16_t>(pc_[lane]);
+    auto &group = nextGroups_[static_cast<std::size_t>(groupOfPc_[pc])];
+    nextLaneOrder_[group.end++] = lane;
+  }
+
+  for (const auto &group : nextGroups_)
+    groupOfPc_[static_cast<std::uint16_t>(group.pc)] = -1;
+  laneOrder_.swap(nextLaneOrder_);
+  groups_.swap(nextGroups_);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "hack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Many Hack CPUs running the same ROM in lockstep, e.g. to try one program
+// with many key sequences. The registers are kept as one array per register
+// and the RAM interleaved by lane, so that lanes at the same pc execute their
+// instruction together in loops the compiler vectorizes. Lanes are kept
+// grouped by pc, and regrouped whenever a jump sends them different ways
+class BatchCpu {
+public:
+  explicit BatchCpu(std::size_t lanes);
+  BatchCpu(const BatchCpu &) = delete;
+  BatchCpu& operator=(const BatchCpu &) = delete;
+
+  void load(const Word *program);
+  // Resets the registers and clears the RAM of every lane
+  void reset();
+  void setKey(std::size_t lane, Word key);
+  // Every lane executes exactly steps instructions
+  void execute(std::size_t steps);
+
+  std::size_t lanes() const;
+  // How many different pcs the lanes are at
+  std::size_t groups() const;
+  Word pc(std::size_t lane) const;
+  Word registerA(std::size_t lane) const;
+  Word registerD(std::size_t lane) const;
+  Word memory(std::size_t lane, std::uint16_t address) const;
+
+private:
+  // The lanes at one pc: laneOrder_[begin, end)
+  struct Group {
+    Word pc;
+    std::size_t begin;
+    std::size_t end;
+  };
+
+  // Returns whether the lanes of the group went to different pcs
+  template <typename LaneOf>
+  bool executeGroup(Group &group, LaneOf laneOf);
+  template <AluFunction ALU, typename LaneOf>
+  void computeGroup(const MicroOp &op, std::size_t count, LaneOf laneOf);
+  void regroup();
+
+  std::size_t numLanes_;
+  std::vector<MicroOp> microProgram_;
+  std::vector<Word> pc_;
+  std::vector<Word> registerA_;
+  std::vector<Word> registerD_;
+  // The whole address space of every lane; word address of lane i is at
+  // address * lanes() + i
+  std::vector<Word> memory_;
+  std::vector<std::size_t> laneOrder_;
+  std::vector<Group> groups_;
+  // The ALU output of every lane of the group being executed, by position
+  std::vector<Word> results_;
+  // Scratch for regroup; groupOfPc_ is indexed by pc and -1 where unused
+  std::vector<std::int32_t> groupOfPc_;
+  std::vector<std::size_t> nextLaneOrder_;
+  std::vector<Group> nextGroups_;
+};
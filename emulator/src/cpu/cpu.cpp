@@ -0,0 +1,651 @@
+#include "cpu.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Every C-instruction the translator emits gets its own specialized handler in
+// the threaded interpreter; anything else in the ROM is handled by GENERIC
+#define THREADED_HANDLERS(X)                        \
+  X(ZERO_JMP,        0b111'0'101010'000'111)        \
+  X(D_JNE,           0b111'0'001100'000'101)        \
+  X(D_JEQ,           0b111'0'001100'000'010)        \
+  X(D_JGT,           0b111'0'001100'000'001)        \
+  X(D_JLT,           0b111'0'001100'000'100)        \
+  X(A_A_MINUS_ONE,   0b111'0'110010'100'000)        \
+  X(A_D_PLUS_A,      0b111'0'000010'100'000)        \
+  X(A_D_MINUS_A,     0b111'0'010011'100'000)        \
+  X(A_M,             0b111'1'110000'100'000)        \
+  X(A_M_MINUS_ONE,   0b111'1'110010'100'000)        \
+  X(AM_M_MINUS_ONE,  0b111'1'110010'101'000)        \
+  X(D_MINUS_ONE,     0b111'0'111010'010'000)        \
+  X(D_ZERO,          0b111'0'101010'010'000)        \
+  X(D_A,             0b111'0'110000'010'000)        \
+  X(D_D_MINUS_A,     0b111'0'010011'010'000)        \
+  X(D_M,             0b111'1'110000'010'000)        \
+  X(D_M_MINUS_D,     0b111'1'000111'010'000)        \
+  X(M_D,             0b111'0'001100'001'000)        \
+  X(M_D_PLUS_ONE,    0b111'0'011111'001'000)        \
+  X(M_D_PLUS_M,      0b111'1'000010'001'000)        \
+  X(M_D_AND_M,       0b111'1'000000'001'000)        \
+  X(M_D_OR_M,        0b111'1'010101'001'000)        \
+  X(M_M_PLUS_ONE,    0b111'1'110111'001'000)        \
+  X(M_M_MINUS_D,     0b111'1'000111'001'000)        \
+  X(M_NEGATE_M,      0b111'1'110011'001'000)        \
+  X(M_NOT_M,         0b111'1'110001'001'000)
+
+#define THREADED_HANDLER_ENUM(name, instruction) name,
+enum class ThreadedHandler : std::uint8_t {
+  A_INSTRUCTION,
+  GENERIC,
+  THREADED_HANDLERS(THREADED_HANDLER_ENUM)
+};
+#undef THREADED_HANDLER_ENUM
+
+ThreadedHandler SelectThreadedHandler(Word instruction) {
+  if (IS_A_INSTRUCTION(instruction)) return ThreadedHandler::A_INSTRUCTION;
+#define THREADED_HANDLER_MATCH(name, encoding) \
+  if (instruction == static_cast<Word>(encoding)) return ThreadedHandler::name;
+  THREADED_HANDLERS(THREADED_HANDLER_MATCH)
+#undef THREADED_HANDLER_MATCH
+  return ThreadedHandler::GENERIC;
+}
+
+// The idle check runs the interpreter with write tracking, so it is only done
+// for a short window every so often. A program usually goes idle soon after a
+// key, so the gap starts small when the key changes and doubles up to the max
+constexpr std::size_t IDLE_PROBE_STEPS = 1 << 15;
+constexpr std::size_t MIN_IDLE_PROBE_INTERVAL = 1 << 16;
+constexpr std::size_t MAX_IDLE_PROBE_INTERVAL = 1 << 22;
+// Bounds and initial value of the number of steps between two clock reads in
+// executeFor, and how often the clock should be read within one budget
+constexpr std::size_t MIN_STEPS_PER_CHECK = 1 << 10;
+constexpr std::size_t MAX_STEPS_PER_CHECK = 1 << 26;
+constexpr std::size_t INITIAL_STEPS_PER_CHECK = 1 << 16;
+constexpr int CHECKS_PER_BUDGET = 16;
+constexpr int MIN_CHECK_INTERVAL_US = 100;
+// Backward jumps to other targets seen before the idle check gives up on the
+// loop it is watching and starts watching the next one
+constexpr std::size_t IDLE_MAX_OTHER_LOOPS = 64;
+// Loops writing more distinct words than this are never considered idle
+constexpr std::size_t IDLE_MAX_WRITES = 1024;
+
+#if defined(__GNUC__)
+#define HACK_COMPUTED_GOTO 1
+#else
+#define HACK_COMPUTED_GOTO 0
+#endif
+
+Cpu::Cpu() :
+  program_(ROM_SIZE, 0),
+  microProgram_(ROM_SIZE, Decode(0)),
+  threadedProgram_(ROM_SIZE,
+      static_cast<std::uint8_t>(ThreadedHandler::A_INSTRUCTION)),
+  threadedCode_(),
+  jit_(),
+  memory_(nullptr),
+  pc_(0),
+  registerA_(0),
+  registerD_(0),
+  cycles_(0),
+  idleCycles_(0),
+  keyEvents_(),
+  dispatchMode_(DispatchMode::LOOP),
+  idle_(false),
+  policy_(Policy::FAST),
+  trace_(),
+  hits_(),
+  jumps_(),
+  stepsUntilProbe_(0),
+  probeInterval_(MIN_IDLE_PROBE_INTERVAL),
+  stepsPerCheck_(INITIAL_STEPS_PER_CHECK),
+  instructionsPerSecond_(0),
+  display_(),
+  displayChanges_(0),
+  writeEpochs_(1 << WORD_WIDTH, 0),
+  writeEpoch_(0),
+  writeLog_(),
+  savedProgram_(),
+  savedPages_()
+{
+
+}
+
+void Cpu::load(const Word *program) {
+  std::copy(program, program + ROM_SIZE, program_.begin());
+  for (std::size_t i = 0; i < ROM_SIZE; ++i) {
+    microProgram_[i] = Decode(program_[i]);
+    threadedProgram_[i] =
+        static_cast<std::uint8_t>(SelectThreadedHandler(program_[i]));
+  }
+  threadedCode_.clear();
+  savedProgram_.reset();
+  idle_ = false;
+  stepsUntilProbe_ = 0;
+  probeInterval_ = MIN_IDLE_PROBE_INTERVAL;
+  if (jit_) jit_->load(program_.data());
+}
+
+void Cpu::setMemoryPtr(Word *memory) {
+  memory_ = memory;
+  displayChanges_ = (1 << DISPLAY_SIZE) - 1;
+}
+
+void Cpu::setDispatchMode(DispatchMode mode) {
+  dispatchMode_ = mode;
+  if (mode == DispatchMode::JIT && !jit_ && Jit::supported()) {
+    jit_ = std::make_unique<Jit>();
+    jit_->load(program_.data());
+  }
+}
+
+void Cpu::setKey(Word key) {
+  if (memory_[KBD] != key) {
+    idle_ = false;
+    stepsUntilProbe_ = std::min(stepsUntilProbe_, MIN_IDLE_PROBE_INTERVAL);
+    probeInterval_ = MIN_IDLE_PROBE_INTERVAL;
+  }
+  memory_[KBD] = key;
+}
+
+void Cpu::queueKey(Word key, std::uint64_t cycle) {
+  if (!keyEvents_.empty()) cycle = std::max(cycle, keyEvents_.back().cycle);
+  keyEvents_.push_back({cycle, key});
+}
+
+bool Cpu::hasQueuedKeys() const {
+  return !keyEvents_.empty();
+}
+
+void Cpu::reset() {
+  pc_ = registerA_ = registerD_ = 0;
+  cycles_ = 0;
+  idleCycles_ = 0;
+  keyEvents_.clear();
+  idle_ = false;
+  stepsUntilProbe_ = 0;
+  probeInterval_ = MIN_IDLE_PROBE_INTERVAL;
+  trace_.clear();
+  displayChanges_ = (1 << DISPLAY_SIZE) - 1;
+}
+
+Cpu::Status Cpu::execute(std::size_t steps) {
+  std::uint64_t end = cycles_ + steps;
+  while (true) {
+    while (!keyEvents_.empty() && keyEvents_.front().cycle <= cycles_) {
+      setKey(keyEvents_.front().key);
+      keyEvents_.pop_front();
+    }
+    if (cycles_ == end) break;
+
+    std::uint64_t until = end;
+    if (!keyEvents_.empty()) until = std::min(until, keyEvents_.front().cycle);
+    if (idle_) {
+      // Spinning on the keyboard until then would not change anything
+      idleCycles_ += until - cycles_;
+      cycles_ = until;
+    } else {
+      cycles_ += executeSteps(static_cast<std::size_t>(until - cycles_));
+    }
+  }
+
+  trackDisplay();
+  return idle_ ? Status::IDLE : Status::RUNNING;
+}
+
+Cpu::Status Cpu::executeFor(
+    std::chrono::microseconds budget, std::size_t maxSteps) {
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  auto deadline = start + budget;
+  // Reading the clock is not free, so it is only read every stepsPerCheck_
+  // steps, which is retuned after every slice to take about this long
+  auto interval = std::max<Clock::duration>(budget / CHECKS_PER_BUDGET,
+      std::chrono::microseconds(MIN_CHECK_INTERVAL_US));
+
+  Status status = Status::RUNNING;
+  std::size_t consumed = 0, executed = 0;
+  auto now = start;
+  while (now < deadline && consumed < maxSteps) {
+    std::size_t slice = std::min(stepsPerCheck_, maxSteps - consumed);
+    status = execute(slice);
+    consumed += slice;
+    auto sliceStart = now;
+    now = Clock::now();
+    // Idle slices only skip ahead to the next queued key
+    if (status == Status::IDLE && hasQueuedKeys()) continue;
+    if (status != Status::RUNNING) break;
+    executed += slice;
+
+    if (slice == stepsPerCheck_) {
+      double ratio = std::chrono::duration<double>(interval).count() /
+          std::max(std::chrono::duration<double>(now - sliceStart).count(),
+              1e-9);
+      ratio = std::clamp(ratio, 0.5, 2.0);
+      stepsPerCheck_ = std::clamp(
+          static_cast<std::size_t>(static_cast<double>(slice) * ratio),
+          MIN_STEPS_PER_CHECK, MAX_STEPS_PER_CHECK);
+    }
+  }
+
+  // Slices that went idle did not run all of their steps, so only the others
+  // are counted
+  double seconds = std::chrono::duration<double>(now - start).count();
+  if (executed > 0 && seconds > 0)
+    instructionsPerSecond_ = static_cast<double>(executed) / seconds;
+  return status;
+}
+
+double Cpu::instructionsPerSecond() const {
+  return instructionsPerSecond_;
+}
+
+std::uint16_t Cpu::takeDisplayChanges() {
+  std::uint16_t changes = displayChanges_;
+  displayChanges_ = 0;
+  return changes;
+}
+
+const Word *Cpu::program() const {
+  return program_.data();
+}
+
+Word *Cpu::memory() const {
+  return memory_;
+}
+
+Word Cpu::pc() const {
+  return pc_;
+}
+
+Word Cpu::registerA() const {
+  return registerA_;
+}
+
+Word Cpu::registerD() const {
+  return registerD_;
+}
+
+std::uint64_t Cpu::cycles() const {
+  return cycles_;
+}
+
+std::uint64_t Cpu::idleCycles() const {
+  return idleCycles_;
+}
+
+void Cpu::setPolicy(Policy policy) {
+  policy_ = policy;
+  if (policy == Policy::PROFILE && hits_.empty()) clearProfile();
+}
+
+void Cpu::setTraceCapacity(std::size_t steps) {
+  trace_.setCapacity(steps);
+}
+
+const TraceBuffer &Cpu::trace() const {
+  return trace_;
+}
+
+void Cpu::clearProfile() {
+  hits_.assign(ROM_SIZE, 0);
+  jumps_.assign(ROM_SIZE, 0);
+}
+
+const std::vector<std::uint64_t> &Cpu::hits() const {
+  return hits_;
+}
+
+const std::vector<std::uint64_t> &Cpu::jumps() const {
+  return jumps_;
+}
+
+template <Cpu::Policy POLICY>
+void Cpu::executeLoop(std::size_t steps) {
+  Word *memory = memory_;
+  Word pc = pc_, a = registerA_, d = registerD_;
+  for (std::size_t step = 0; step < steps; ++step) {
+    onFetch<POLICY>(pc, a, d);
+    Word source = pc++;
+    const MicroOp &op = microProgram_[static_cast<std::size_t>(source)];
+    if (op.alu == AluFunction::LOAD_A) {
+      a = op.instruction;
+      onRetire<POLICY>(op, source, a, d, false, a, d);
+      continue;
+    }
+
+    onExecute<POLICY>(op, source, a, d);
+    Word address = a, sourceD = d;
+    ExecuteC(op, memory, pc, a, d);
+    // A jump to the next address is indistinguishable from none
+    onRetire<POLICY>(op, source, address, sourceD, pc != source + 1, a, d);
+  }
+
+  pc_ = pc;
+  registerA_ = a;
+  registerD_ = d;
+}
+
+// The hooks the loop interpreter and the idle probe call around every
+// instruction; each one compiles to nothing under FAST
+
+template <Cpu::Policy POLICY>
+void Cpu::onFetch(Word pc, Word a, Word d) {
+  if constexpr (POLICY == Policy::CHECKED) {
+    if (pc < 0 || static_cast<std::size_t>(pc) >= ROM_SIZE)
+      fault("pc is outside of the ROM", pc, a, d);
+  } else if constexpr (POLICY == Policy::PROFILE) {
+    ++hits_[static_cast<std::size_t>(pc)];
+  }
+}
+
+template <Cpu::Policy POLICY>
+void Cpu::onExecute(const MicroOp &op, Word pc, Word a, Word d) {
+  if constexpr (POLICY == Policy::CHECKED) {
+    if ((op.useM || (op.dest & DEST_MASK_M)) &&
+        static_cast<std::uint16_t>(a) >= RAM_SIZE)
+      fault("RAM access at " + std::to_string(static_cast<std::uint16_t>(a)) +
+            " is outside of the RAM", pc, a, d);
+  }
+}
+
+template <Cpu::Policy POLICY>
+void Cpu::onRetire(const MicroOp &op, Word source, Word address, Word sourceD,
+                   bool jumped, Word a, Word d) {
+  if constexpr (POLICY == Policy::CHECKED) {
+    // Like the other faults, reports the instruction and the registers it
+    // started with; only the write to SP has happened
+    if ((op.dest & DEST_MASK_M) && address == 0 && memory_[0] >= DISPLAY)
+      fault("stack overflow into the display", source, address, sourceD);
+  } else if constexpr (POLICY == Policy::TRACE) {
+    bool wrote = op.dest & DEST_MASK_M;
+    auto written = static_cast<std::uint16_t>(address);
+    trace_.record({source, a, d, wrote, wrote ? written : std::uint16_t{0},
+                   wrote ? memory_[written] : Word{0}});
+  } else if constexpr (POLICY == Policy::PROFILE) {
+    if (jumped) ++jumps_[static_cast<std::size_t>(source)];
+  }
+}
+
+void Cpu::fault(const std::string &message, Word pc, Word a, Word d) {
+  pc_ = pc;
+  registerA_ = a;
+  registerD_ = d;
+  throw std::runtime_error("Address " + std::to_string(pc) + ": " + message);
+}
+
+// The only input of the machine is KBD, so when it takes a backward jump to the
+// same address with the same D as last time (A is the address) and every word
+// written in between holds its old value again, it is in exactly the same state
+// and will keep going around that loop until the key changes. Stops right there
+// and sets idle_ if so
+template <Cpu::Policy POLICY>
+std::size_t Cpu::probeIdle(std::size_t steps) {
+  Word *memory = memory_;
+  Word pc = pc_, a = registerA_, d = registerD_;
+  Word loopPc = 0, loopD = 0;
+  bool watching = false;
+  std::size_t otherLoops = 0;
+  ++writeEpoch_;
+  writeLog_.clear();
+
+  std::size_t step = 0;
+  while (step < steps) {
+    ++step;
+    onFetch<POLICY>(pc, a, d);
+    Word source = pc;
+    const MicroOp &op = microProgram_[static_cast<std::size_t>(pc++)];
+    if (op.alu == AluFunction::LOAD_A) {
+      a = op.instruction;
+      onRetire<POLICY>(op, source, a, d, false, a, d);
+      continue;
+    }
+
+    onExecute<POLICY>(op, source, a, d);
+    Word y = op.useM ? memory[a & 0xffff] : a;
+    Word result = Compute(op.alu, op.instruction, d, y);
+    if (op.dest & DEST_MASK_M) {
+      auto address = static_cast<std::uint16_t>(a);
+      if (writeEpochs_[address] != writeEpoch_) {
+        writeEpochs_[address] = writeEpoch_;
+        writeLog_.push_back({address, memory[address]});
+      }
+      memory[address] = result;
+    }
+    Word address = a, sourceD = d;
+    if (op.dest & DEST_MASK_A) a = result;
+    if (op.dest & DEST_MASK_D) d = result;
+    bool jumped = op.jump & JumpCondition(result);
+    if (jumped) pc = a;
+    onRetire<POLICY>(op, source, address, sourceD, jumped, a, d);
+    if (!jumped || pc > source) continue;
+    if (watching && pc == loopPc) {
+      bool unchanged = d == loopD && writeLog_.size() <= IDLE_MAX_WRITES &&
+          std::all_of(writeLog_.begin(), writeLog_.end(),
+              [memory](const WriteLogEntry &entry) {
+                return memory[entry.address] == entry.value;
+              });
+      if (unchanged) {
+        idle_ = true;
+        break;
+      }
+    } else if (watching && ++otherLoops < IDLE_MAX_OTHER_LOOPS) {
+      continue;
+    }
+    watching = true;
+    otherLoops = 0;
+    loopPc = pc;
+    loopD = d;
+    ++writeEpoch_;
+    writeLog_.clear();
+  }
+
+  pc_ = pc;
+  registerA_ = a;
+  registerD_ = d;
+  return step;
+}
+
+// Runs until steps are used up or the program goes idle and returns the number
+// of steps executed
+std::size_t Cpu::executeSteps(std::size_t steps) {
+  std::size_t executed = 0;
+  while (executed < steps && !idle_) {
+    if (stepsUntilProbe_ == 0) {
+      std::size_t probeSteps = std::min(steps - executed, IDLE_PROBE_STEPS);
+      switch (policy_) {
+        case Policy::CHECKED:
+          executed += probeIdle<Policy::CHECKED>(probeSteps);
+          break;
+        case Policy::TRACE:
+          executed += probeIdle<Policy::TRACE>(probeSteps);
+          break;
+        case Policy::PROFILE:
+          executed += probeIdle<Policy::PROFILE>(probeSteps);
+          break;
+        default:
+          executed += probeIdle<Policy::FAST>(probeSteps);
+          break;
+      }
+      stepsUntilProbe_ = probeInterval_;
+      probeInterval_ = std::min(probeInterval_ * 2, MAX_IDLE_PROBE_INTERVAL);
+      continue;
+    }
+
+    std::size_t chunk = std::min(steps - executed, stepsUntilProbe_);
+    executed += chunk;
+    stepsUntilProbe_ -= chunk;
+    if (policy_ != Policy::FAST) {
+      switch (policy_) {
+        case Policy::CHECKED:
+          executeLoop<Policy::CHECKED>(chunk);
+          break;
+        case Policy::TRACE:
+          executeLoop<Policy::TRACE>(chunk);
+          break;
+        default:
+          executeLoop<Policy::PROFILE>(chunk);
+          break;
+      }
+      continue;
+    }
+    switch (dispatchMode_) {
+      case DispatchMode::THREADED:
+        executeThreaded(chunk);
+        break;
+      case DispatchMode::JIT:
+        // Whatever is left is too short for the next block
+        if (jit_)
+          chunk = jit_->execute(memory_, pc_, registerA_, registerD_, chunk);
+        executeLoop<Policy::FAST>(chunk);
+        break;
+      default:
+        executeLoop<Policy::FAST>(chunk);
+        break;
+    }
+  }
+  return executed;
+}
+
+Cpu::State Cpu::saveState() {
+  State state;
+  if (!savedProgram_)
+    savedProgram_ = std::make_shared<const std::vector<Word>>(program_);
+  state.program_ = savedProgram_;
+
+  savedPages_.resize(NUM_PAGES);
+  state.pages_.resize(NUM_PAGES);
+  for (std::size_t i = 0; i < NUM_PAGES; ++i) {
+    const Word *begin = memory_ + i * PAGE_SIZE;
+    std::size_t size = std::min(PAGE_SIZE, RAM_SIZE - i * PAGE_SIZE);
+    auto &saved = savedPages_[i];
+    if (!saved || !std::equal(begin, begin + size, saved->begin())) {
+      auto page = std::make_shared<State::Page>();
+      std::copy(begin, begin + size, page->begin());
+      saved = std::move(page);
+    }
+    state.pages_[i] = saved;
+  }
+
+  state.pc_ = pc_;
+  state.registerA_ = registerA_;
+  state.registerD_ = registerD_;
+  state.cycles_ = cycles_;
+  state.idleCycles_ = idleCycles_;
+  state.keyEvents_ = keyEvents_;
+  state.idle_ = idle_;
+  return state;
+}
+
+void Cpu::loadState(const State &state) {
+  if (state.program_ != savedProgram_) {
+    load(state.program_->data());
+    savedProgram_ = state.program_;
+  }
+
+  for (std::size_t i = 0; i < NUM_PAGES; ++i) {
+    Word *begin = memory_ + i * PAGE_SIZE;
+    std::size_t size = std::min(PAGE_SIZE, RAM_SIZE - i * PAGE_SIZE);
+    const auto &page = *state.pages_[i];
+    if (!std::equal(begin, begin + size, page.begin()))
+      std::copy(page.begin(), page.begin() + size, begin);
+  }
+  savedPages_ = state.pages_;
+
+  pc_ = state.pc_;
+  registerA_ = state.registerA_;
+  registerD_ = state.registerD_;
+  cycles_ = state.cycles_;
+  idleCycles_ = state.idleCycles_;
+  keyEvents_ = state.keyEvents_;
+  idle_ = state.idle_;
+  stepsUntilProbe_ = 0;
+  probeInterval_ = MIN_IDLE_PROBE_INTERVAL;
+  displayChanges_ = (1 << DISPLAY_SIZE) - 1;
+}
+
+void Cpu::trackDisplay() {
+  for (std::size_t i = 0; i < DISPLAY_SIZE; ++i) {
+    Word value = memory_[static_cast<std::size_t>(DISPLAY) + i];
+    if (display_[i] != value) {
+      display_[i] = value;
+      displayChanges_ |= static_cast<std::uint16_t>(1 << i);
+    }
+  }
+}
+
+#if HACK_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define THREADED_LABEL(name) HANDLER_##name:
+#define THREADED_DISPATCH() \
+    if (++step == steps) goto done; \
+    goto *threadedCode[pc];
+#else
+#define THREADED_LABEL(name) case ThreadedHandler::name:
+#define THREADED_DISPATCH() break;
+#endif
+
+#define THREADED_HANDLER(name, encoding)                                    \
+    THREADED_LABEL(name) {                                                  \
+      constexpr MicroOp op = Decode(static_cast<Word>(encoding));           \
+      ++pc;                                                                 \
+      ExecuteC<op.alu, op.useM, op.dest, op.jump>(op.instruction, memory, pc, a, d); \
+      THREADED_DISPATCH()                                                   \
+    }
+
+void Cpu::executeThreaded(std::size_t steps) {
+  if (steps == 0) return;
+
+  const Word *program = program_.data();
+  const MicroOp *microProgram = microProgram_.data();
+  Word *memory = memory_;
+  Word pc = pc_, a = registerA_, d = registerD_;
+  std::size_t step = 0;
+
+#if HACK_COMPUTED_GOTO
+#define THREADED_HANDLER_ADDRESS(name, encoding) &&HANDLER_##name,
+  static void *const handlerAddresses[] = {
+    &&HANDLER_A_INSTRUCTION,
+    &&HANDLER_GENERIC,
+    THREADED_HANDLERS(THREADED_HANDLER_ADDRESS)
+  };
+#undef THREADED_HANDLER_ADDRESS
+  if (threadedCode_.empty()) {
+    threadedCode_.resize(ROM_SIZE);
+    for (std::size_t i = 0; i < ROM_SIZE; ++i)
+      threadedCode_[i] = handlerAddresses[threadedProgram_[i]];
+  }
+  void *const *threadedCode = threadedCode_.data();
+
+  goto *threadedCode[pc];
+#else
+  for (;; ++step) {
+    if (step == steps) goto done;
+    switch (static_cast<ThreadedHandler>(threadedProgram_[pc])) {
+#endif
+      THREADED_LABEL(A_INSTRUCTION) {
+        a = program[pc++];
+        THREADED_DISPATCH()
+      }
+      THREADED_LABEL(GENERIC) {
+        ExecuteC(microProgram[pc++], memory, pc, a, d);
+        THREADED_DISPATCH()
+      }
+      THREADED_HANDLERS(THREADED_HANDLER)
+#if !HACK_COMPUTED_GOTO
+    }
+  }
+#endif
+
+done:
+  pc_ = pc;
+  registerA_ = a;
+  registerD_ = d;
+}
+
+#undef THREADED_HANDLER
+#undef THREADED_DISPATCH
+#undef THREADED_LABEL
+#if HACK_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
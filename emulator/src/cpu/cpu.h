@@ -0,0 +1,203 @@
+#pragma once
+
+#include "hack.h"
+#include "jit.h"
+#include "trace.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The Hack CPU: the ROM in its decoded forms, the registers and a pointer to
+// the RAM, which is owned by whoever drives the CPU
+class Cpu {
+public:
+  enum class DispatchMode {
+    LOOP,
+    THREADED,
+    JIT
+  };
+
+  // How execute runs the program. Every policy but FAST goes through the loop
+  // interpreter, which is instantiated once per policy, so FAST pays nothing
+  // for the others:
+  //   CHECKED stops with an exception when pc leaves the ROM, an instruction
+  //           accesses RAM beyond RAM_SIZE or SP grows into the display
+  //   TRACE   records pc, A, D and the word written to RAM of every step in
+  //           the trace ring buffer
+  //   PROFILE counts the hits and taken jumps of every ROM address
+  enum class Policy {
+    FAST,
+    CHECKED,
+    TRACE,
+    PROFILE
+  };
+
+  // What the CPU is doing when execute returns. IDLE means the program is
+  // spinning on the keyboard without changing anything else, so running it any
+  // further is pointless until the key changes
+  enum class Status {
+    RUNNING,
+    HALTED,
+    IDLE
+  };
+
+  // RAM is saved in pages of this many words
+  static constexpr std::size_t PAGE_SIZE = 512;
+  static constexpr std::size_t NUM_PAGES =
+      (RAM_SIZE + PAGE_SIZE - 1) / PAGE_SIZE;
+
+  class State;
+
+  Cpu();
+  Cpu(const Cpu &) = delete;
+  Cpu& operator=(const Cpu &) = delete;
+
+  void load(const Word *program);
+  void setMemoryPtr(Word *memory);
+  void setDispatchMode(DispatchMode mode);
+  void setKey(Word key);
+  // Sets KBD to key once cycles() reaches cycle, between two instructions. A
+  // key queued for an earlier cycle than the last queued one follows it
+  void queueKey(Word key, std::uint64_t cycle);
+  bool hasQueuedKeys() const;
+  void reset();
+  // Always advances cycles() by steps. Time spent idle is skipped, up to the
+  // next queued key
+  Status execute(std::size_t steps);
+  // Runs until either the budget of wall time or maxSteps is used up, or the
+  // program stops running
+  Status executeFor(std::chrono::microseconds budget, std::size_t maxSteps);
+  // Measured over the last executeFor call that did not go idle
+  double instructionsPerSecond() const;
+  // Bit i is set if DISPLAY + i changed since the last call; everything counts
+  // as changed after setMemoryPtr and reset
+  std::uint16_t takeDisplayChanges();
+
+  const Word *program() const;
+  Word *memory() const;
+  Word pc() const;
+  Word registerA() const;
+  Word registerD() const;
+  // Instructions executed or skipped while idle since the last reset
+  std::uint64_t cycles() const;
+  // Of cycles(), those skipped while idle
+  std::uint64_t idleCycles() const;
+
+  void setPolicy(Policy policy);
+  // Sets how many of the last steps the trace keeps, and clears it
+  void setTraceCapacity(std::size_t steps);
+  const TraceBuffer &trace() const;
+  void clearProfile();
+  const std::vector<std::uint64_t> &hits() const;
+  const std::vector<std::uint64_t> &jumps() const;
+
+  // Saves the ROM, the registers, the queued keys and the first RAM_SIZE words
+  // of the RAM. Pages that have not changed since the last state this CPU
+  // saved or loaded are shared with it instead of copied
+  State saveState();
+  // Only the pages that differ from the current RAM are copied back, and the
+  // ROM is only decoded again if it is not the one already loaded
+  void loadState(const State &state);
+
+private:
+  struct KeyEvent {
+    std::uint64_t cycle;
+    Word key;
+  };
+
+  struct WriteLogEntry {
+    std::uint16_t address;
+    Word value;
+  };
+
+  std::size_t executeSteps(std::size_t steps);
+  template <Policy POLICY>
+  void executeLoop(std::size_t steps);
+  void executeThreaded(std::size_t steps);
+  template <Policy POLICY>
+  std::size_t probeIdle(std::size_t steps);
+  template <Policy POLICY>
+  void onFetch(Word pc, Word a, Word d);
+  template <Policy POLICY>
+  void onExecute(const MicroOp &op, Word pc, Word a, Word d);
+  template <Policy POLICY>
+  void onRetire(const MicroOp &op, Word source, Word address, Word sourceD,
+                bool jumped, Word a, Word d);
+  [[noreturn]] void fault(const std::string &message, Word pc, Word a, Word d);
+  void trackDisplay();
+
+  std::vector<Word> program_;
+  std::vector<MicroOp> microProgram_;
+  std::vector<std::uint8_t> threadedProgram_;
+  std::vector<void *> threadedCode_;
+  std::unique_ptr<Jit> jit_;
+
+  Word *memory_;
+  Word pc_;
+  Word registerA_;
+  Word registerD_;
+  std::uint64_t cycles_;
+  std::uint64_t idleCycles_;
+  std::deque<KeyEvent> keyEvents_;
+  DispatchMode dispatchMode_;
+  bool idle_;
+  Policy policy_;
+  TraceBuffer trace_;
+  std::vector<std::uint64_t> hits_;
+  std::vector<std::uint64_t> jumps_;
+  std::size_t stepsUntilProbe_;
+  std::size_t probeInterval_;
+  std::size_t stepsPerCheck_;
+  double instructionsPerSecond_;
+  // The display as of the last execute call, compared after every call so that
+  // no engine has to watch its writes
+  std::array<Word, DISPLAY_SIZE> display_;
+  std::uint16_t displayChanges_;
+  // Words written by probeIdle since the loop it watches was last entered,
+  // with their values from back then
+  std::vector<std::uint32_t> writeEpochs_;
+  std::uint32_t writeEpoch_;
+  std::vector<WriteLogEntry> writeLog_;
+  // What the last saved or loaded state holds, to share with the next one
+  std::shared_ptr<const std::vector<Word>> savedProgram_;
+  std::vector<std::shared_ptr<const std::array<Word, PAGE_SIZE>>> savedPages_;
+};
+
+// A saved machine state. Copying it is cheap, as the ROM and the RAM pages are
+// immutable and shared by every state with the same contents
+class Cpu::State {
+public:
+  State() :
+    program_(),
+    pages_(),
+    pc_(0),
+    registerA_(0),
+    registerD_(0),
+    cycles_(0),
+    idleCycles_(0),
+    keyEvents_(),
+    idle_(false)
+  {
+
+  }
+
+private:
+  friend class Cpu;
+  using Page = std::array<Word, PAGE_SIZE>;
+
+  std::shared_ptr<const std::vector<Word>> program_;
+  std::vector<std::shared_ptr<const Page>> pages_;
+  Word pc_;
+  Word registerA_;
+  Word registerD_;
+  std::uint64_t cycles_;
+  std::uint64_t idleCycles_;
+  std::deque<KeyEvent> keyEvents_;
+  bool idle_;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+using Word = std::int16_t;
+constexpr int WORD_WIDTH = 16;
+constexpr std::size_t ROM_SIZE = 32768;
+constexpr std::size_t RAM_SIZE = 24577;
+// Display goes from DISPLAY to DISPLAY + DISPLAY_SIZE - 1, from least
+// significant digit to most significant digit
+constexpr Word DISPLAY = 16384;
+constexpr std::size_t DISPLAY_SIZE = 13;
+constexpr Word KBD = 16397;
+
+#define IS_A_INSTRUCTION(instruction)   ~(((instruction) >> (WORD_WIDTH - 1)))
+#define IS_C_INSTRUCTION(instruction)   ((instruction) >> (WORD_WIDTH - 1))
+
+
+#define USE_REGISTER_M(instruction)     (((instruction) >> 12) & 1)
+
+#define ZERO_X(instruction)             (((instruction) >> 11) & 1)
+#define NEGATE_X(instruction)           (((instruction) >> 10) & 1)
+#define ZERO_Y(instruction)             (((instruction) >>  9) & 1)
+#define NEGATE_Y(instruction)           (((instruction) >>  8) & 1)
+#define ALU_ADD(instruction)            (((instruction) >>  7) & 1)
+#define NEGATE_OUT(instruction)         (((instruction) >>  6) & 1)
+
+#define DEST_A(instruction)             (((instruction) >>  5) & 1)
+#define DEST_D(instruction)             (((instruction) >>  4) & 1)
+#define DEST_M(instruction)             (((instruction) >>  3) & 1)
+
+#define JLT(instruction)                (((instruction) >>  2) & 1)
+#define JEQ(instruction)                (((instruction) >>  1) & 1)
+#define JGT(instruction)                (((instruction)      ) & 1)
+
+#define COMPUTATION(instruction)        (((instruction) >>  6) & 0x3f)
+#define DESTINATION(instruction)        (((instruction) >>  3) & 0x7)
+#define JUMP(instruction)               (((instruction)      ) & 0x7)
+
+// ALU functions of the Hack CPU, named after the computation they perform with
+// x = D and y = A (or M). Computations outside of the Hack specification fall
+// back to GENERIC, which evaluates the ALU control bits one by one
+enum class AluFunction : std::uint8_t {
+  LOAD_A,
+  ZERO,
+  ONE,
+  MINUS_ONE,
+  X,
+  Y,
+  NOT_X,
+  NOT_Y,
+  NEGATE_X,
+  NEGATE_Y,
+  X_PLUS_ONE,
+  Y_PLUS_ONE,
+  X_MINUS_ONE,
+  Y_MINUS_ONE,
+  X_PLUS_Y,
+  X_MINUS_Y,
+  Y_MINUS_X,
+  X_AND_Y,
+  X_OR_Y,
+  GENERIC
+};
+
+constexpr std::uint8_t DEST_MASK_M = 1 << 0;
+constexpr std::uint8_t DEST_MASK_D = 1 << 1;
+constexpr std::uint8_t DEST_MASK_A = 1 << 2;
+
+constexpr std::uint8_t JUMP_MASK_GT = 1 << 0;
+constexpr std::uint8_t JUMP_MASK_EQ = 1 << 1;
+constexpr std::uint8_t JUMP_MASK_LT = 1 << 2;
+
+// An instruction decoded once by Assemble, so that Execute only has to look up
+// what to do instead of extracting every field of the instruction again
+struct MicroOp {
+  Word instruction;
+  AluFunction alu;
+  bool useM;
+  std::uint8_t dest;
+  std::uint8_t jump;
+};
+
+constexpr AluFunction DecodeAluFunction(Word instruction) {
+  switch (COMPUTATION(instruction)) {
+    case 0b101010: return AluFunction::ZERO;
+    case 0b111111: return AluFunction::ONE;
+    case 0b111010: return AluFunction::MINUS_ONE;
+    case 0b001100: return AluFunction::X;
+    case 0b110000: return AluFunction::Y;
+    case 0b001101: return AluFunction::NOT_X;
+    case 0b110001: return AluFunction::NOT_Y;
+    case 0b001111: return AluFunction::NEGATE_X;
+    case 0b110011: return AluFunction::NEGATE_Y;
+    case 0b011111: return AluFunction::X_PLUS_ONE;
+    case 0b110111: return AluFunction::Y_PLUS_ONE;
+    case 0b001110: return AluFunction::X_MINUS_ONE;
+    case 0b110010: return AluFunction::Y_MINUS_ONE;
+    case 0b000010: return AluFunction::X_PLUS_Y;
+    case 0b010011: return AluFunction::X_MINUS_Y;
+    case 0b000111: return AluFunction::Y_MINUS_X;
+    case 0b000000: return AluFunction::X_AND_Y;
+    case 0b010101: return AluFunction::X_OR_Y;
+    default:       return AluFunction::GENERIC;
+  }
+}
+
+constexpr MicroOp Decode(Word instruction) {
+  MicroOp op{instruction, AluFunction::LOAD_A, false, 0, 0};
+  if (IS_A_INSTRUCTION(instruction)) return op;
+
+  op.alu = DecodeAluFunction(instruction);
+  op.useM = USE_REGISTER_M(instruction);
+  op.dest = static_cast<std::uint8_t>(
+      (DEST_M(instruction) ? DEST_MASK_M : 0) |
+      (DEST_D(instruction) ? DEST_MASK_D : 0) |
+      (DEST_A(instruction) ? DEST_MASK_A : 0));
+  op.jump = static_cast<std::uint8_t>(
+      (JGT(instruction) ? JUMP_MASK_GT : 0) |
+      (JEQ(instruction) ? JUMP_MASK_EQ : 0) |
+      (JLT(instruction) ? JUMP_MASK_LT : 0));
+  return op;
+}
+
+inline Word GenericAlu(Word instruction, Word x, Word y) {
+  x = ~(-  ZERO_X(instruction)) & x;
+  x =  (-NEGATE_X(instruction)) ^ x;
+  y = ~(-  ZERO_Y(instruction)) & y;
+  y =  (-NEGATE_Y(instruction)) ^ y;
+  Word result = ALU_ADD(instruction) ? (x + y) : (x & y);
+  return (-NEGATE_OUT(instruction)) ^ result;
+}
+
+// Maps the sign of an ALU result to the jump mask bit it satisfies
+inline std::uint8_t JumpCondition(Word result) {
+  return result < 0 ? JUMP_MASK_LT : (result == 0 ? JUMP_MASK_EQ : JUMP_MASK_GT);
+}
+
+inline Word Compute(AluFunction alu, Word instruction, Word x, Word y) {
+  switch (alu) {
+    case AluFunction::ZERO:        return 0;
+    case AluFunction::ONE:         return 1;
+    case AluFunction::MINUS_ONE:   return -1;
+    case AluFunction::X:           return x;
+    case AluFunction::Y:           return y;
+    case AluFunction::NOT_X:       return static_cast<Word>(~x);
+    case AluFunction::NOT_Y:       return static_cast<Word>(~y);
+    case AluFunction::NEGATE_X:    return static_cast<Word>(-x);
+    case AluFunction::NEGATE_Y:    return static_cast<Word>(-y);
+    case AluFunction::X_PLUS_ONE:  return static_cast<Word>(x + 1);
+    case AluFunction::Y_PLUS_ONE:  return static_cast<Word>(y + 1);
+    case AluFunction::X_MINUS_ONE: return static_cast<Word>(x - 1);
+    case AluFunction::Y_MINUS_ONE: return static_cast<Word>(y - 1);
+    case AluFunction::X_PLUS_Y:    return static_cast<Word>(x + y);
+    case AluFunction::X_MINUS_Y:   return static_cast<Word>(x - y);
+    case AluFunction::Y_MINUS_X:   return static_cast<Word>(y - x);
+    case AluFunction::X_AND_Y:     return static_cast<Word>(x & y);
+    case AluFunction::X_OR_Y:      return static_cast<Word>(x | y);
+    default:                       return GenericAlu(instruction, x, y);
+  }
+}
+
+// Executes a C-instruction whose fields are known at compile time, so that
+// the ALU function, destinations and jump condition are all folded away
+template <AluFunction ALU, bool USE_M, std::uint8_t DEST, std::uint8_t JUMP>
+inline void ExecuteC(Word instruction, Word *memory, Word &pc, Word &a, Word &d) {
+  Word y = USE_M ? memory[a & 0xffff] : a;
+  Word result = Compute(ALU, instruction, d, y);
+
+  if (DEST & DEST_MASK_M) memory[a & 0xffff] = result;
+  if (DEST & DEST_MASK_A) a = result;
+  if (DEST & DEST_MASK_D) d = result;
+
+  if (JUMP & JumpCondition(result)) pc = a;
+}
+
+inline void ExecuteC(const MicroOp &op, Word *memory, Word &pc, Word &a, Word &d) {
+  Word y = op.useM ? memory[a & 0xffff] : a;
+  Word result = Compute(op.alu, op.instruction, d, y);
+
+  if (op.dest & DEST_MASK_M) memory[a & 0xffff] = result;
+  if (op.dest & DEST_MASK_A) a = result;
+  if (op.dest & DEST_MASK_D) d = result;
+
+  if (op.jump & JumpCondition(result)) pc = a;
+}
@@ -0,0 +1,290 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#if HACK_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+constexpr std::size_t CODE_SIZE = 32 << 20;
+constexpr std::size_t TABLE_SIZE = 1 << WORD_WIDTH;
+constexpr std::size_t MAX_BLOCK_LENGTH = 256;
+constexpr std::size_t MAX_INSTRUCTION_BYTES = 48;
+constexpr std::size_t MAX_BLOCK_BYTES =
+    MAX_BLOCK_LENGTH * MAX_INSTRUCTION_BYTES + 64;
+
+// Register allocation of the generated code:
+//   rbx: State *         rbp: block table       r12d: A     r13d: D
+//   r14: memory          r15: steps left        eax: result / next pc
+//   ecx: address         edx: y
+// Only the low 16 bits of A and D are meaningful; every use either works on
+// 16-bit operands or zero extends them first
+
+// cmovCC opcodes for the jump field (JLT JEQ JGT) of a C-instruction
+constexpr std::uint8_t CMOV_OPCODES[8] = {
+  0x00, // never
+  0x4f, // JGT: cmovg
+  0x44, // JEQ: cmove
+  0x4d, // JGE: cmovge
+  0x4c, // JLT: cmovl
+  0x45, // JNE: cmovne
+  0x4e, // JLE: cmovle
+  0x00  // JMP: always
+};
+
+} // namespace
+
+Jit::Jit() :
+  program_(),
+  isTarget_(ROM_SIZE, false),
+  table_(TABLE_SIZE, nullptr),
+  code_(nullptr),
+  codeSize_(0),
+  codeUsed_(0),
+  enter_(nullptr),
+  dispatch_(nullptr),
+  leave_(nullptr)
+{
+#if HACK_JIT_SUPPORTED
+  void *code = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED)
+    throw std::runtime_error("Cannot allocate memory for the JIT");
+  code_ = static_cast<std::uint8_t *>(code);
+  codeSize_ = CODE_SIZE;
+  flush();
+#endif
+}
+
+Jit::~Jit() {
+#if HACK_JIT_SUPPORTED
+  if (code_) munmap(code_, codeSize_);
+#endif
+}
+
+bool Jit::supported() {
+  return HACK_JIT_SUPPORTED;
+}
+
+void Jit::load(const Word *program) {
+  std::memcpy(program_, program, sizeof(program_));
+
+  // Any constant loaded into A may be used as a jump target, so a block is
+  // started at each of them to avoid compiling the same code twice
+  std::fill(isTarget_.begin(), isTarget_.end(), false);
+  isTarget_[0] = true;
+  for (std::size_t i = 0; i < ROM_SIZE; ++i) {
+    Word instruction = program_[i];
+    if (IS_A_INSTRUCTION(instruction) &&
+        static_cast<std::size_t>(instruction) < ROM_SIZE)
+      isTarget_[static_cast<std::size_t>(instruction)] = true;
+  }
+
+  flush();
+}
+
+std::size_t Jit::execute(
+    Word *memory, Word &pc, Word &registerA, Word &registerD,
+    std::size_t steps) {
+#if HACK_JIT_SUPPORTED
+  State state{table_.data(), memory, steps, pc, registerA, registerD};
+  while (true) {
+    reinterpret_cast<void (*)(State *)>(enter_)(&state);
+
+    auto nextPc = static_cast<std::uint16_t>(state.pc);
+    if (nextPc >= ROM_SIZE || table_[nextPc] != leave_) break;
+    compile(nextPc);
+  }
+
+  pc = state.pc;
+  registerA = state.registerA;
+  registerD = state.registerD;
+  return static_cast<std::size_t>(state.steps);
+#else
+  static_cast<void>(memory);
+  static_cast<void>(pc);
+  static_cast<void>(registerA);
+  static_cast<void>(registerD);
+  return steps;
+#endif
+}
+
+void Jit::flush() {
+  if (!code_) return;
+
+  writable(true);
+  codeUsed_ = 0;
+  emitRuntime();
+  writable(false);
+
+  std::fill(table_.begin(), table_.end(), leave_);
+}
+
+void Jit::compile(std::size_t entry) {
+  std::size_t end = entry;
+  while (true) {
+    Word instruction = program_[end++];
+    if (IS_C_INSTRUCTION(instruction) && JUMP(instruction)) break;
+    if (end == ROM_SIZE || isTarget_[end]) break;
+    if (end - entry == MAX_BLOCK_LENGTH) break;
+  }
+  auto length = static_cast<std::uint32_t>(end - entry);
+
+  if (codeUsed_ + MAX_BLOCK_BYTES > codeSize_) flush();
+  writable(true);
+
+  // bail: mov eax, entry; jmp leave
+  std::uint8_t *bail = code_ + codeUsed_;
+  emit({0xb8});
+  emit32(static_cast<std::uint32_t>(entry));
+  emitJump(leave_);
+
+  // cmp r15, length; jb bail; sub r15, length
+  std::uint8_t *block = code_ + codeUsed_;
+  emit({0x49, 0x81, 0xff});
+  emit32(length);
+  emit({0x0f, 0x82});
+  emit32(static_cast<std::uint32_t>(bail - (code_ + codeUsed_ + 4)));
+  emit({0x49, 0x81, 0xef});
+  emit32(length);
+
+  for (std::size_t i = entry; i < end; ++i)
+    emitInstruction(program_[i]);
+
+  Word last = program_[end - 1];
+  if (IS_C_INSTRUCTION(last) && JUMP(last) == 0b111) {
+    // movzx eax, r12w
+    emit({0x41, 0x0f, 0xb7, 0xc4});
+  } else if (IS_C_INSTRUCTION(last) && JUMP(last)) {
+    // movzx ecx, r12w; mov edx, end; test ax, ax; cmovCC edx, ecx; mov eax, edx
+    emit({0x41, 0x0f, 0xb7, 0xcc});
+    emit({0xba});
+    emit32(static_cast<std::uint32_t>(end));
+    emit({0x66, 0x85, 0xc0});
+    emit({0x0f, CMOV_OPCODES[JUMP(last)], 0xd1});
+    emit({0x89, 0xd0});
+  } else {
+    // mov eax, end
+    emit({0xb8});
+    emit32(static_cast<std::uint32_t>(end));
+  }
+  emitJump(dispatch_);
+
+  writable(false);
+  table_[entry] = block;
+}
+
+void Jit::emitRuntime() {
+  // enter(State *state): save the callee-saved registers and load the state
+  enter_ = code_ + codeUsed_;
+  emit({0x53});                                       // push rbx
+  emit({0x55});                                       // push rbp
+  emit({0x41, 0x54});                                 // push r12
+  emit({0x41, 0x55});                                 // push r13
+  emit({0x41, 0x56});                                 // push r14
+  emit({0x41, 0x57});                                 // push r15
+  emit({0x48, 0x89, 0xfb});                           // mov rbx, rdi
+  emit({0x48, 0x8b, 0x6b, offsetof(State, table)});   // mov rbp, [rbx + table]
+  emit({0x4c, 0x8b, 0x73, offsetof(State, memory)});  // mov r14, [rbx + memory]
+  emit({0x4c, 0x8b, 0x7b, offsetof(State, steps)});   // mov r15, [rbx + steps]
+  emit({0x44, 0x0f, 0xbf, 0x63,
+        offsetof(State, registerA)});                 // movsx r12d, [rbx + A]
+  emit({0x44, 0x0f, 0xbf, 0x6b,
+        offsetof(State, registerD)});                 // movsx r13d, [rbx + D]
+  emit({0x0f, 0xb7, 0x43, offsetof(State, pc)});      // movzx eax, [rbx + pc]
+
+  // dispatch: jump to the block at pc = eax
+  dispatch_ = code_ + codeUsed_;
+  emit({0x48, 0x8b, 0x4c, 0xc5, 0x00});               // mov rcx, [rbp + rax * 8]
+  emit({0xff, 0xe1});                                 // jmp rcx
+
+  // leave: store the state and return to C++ with pc = eax
+  leave_ = code_ + codeUsed_;
+  emit({0x66, 0x44, 0x89, 0x63,
+        offsetof(State, registerA)});                 // mov [rbx + A], r12w
+  emit({0x66, 0x44, 0x89, 0x6b,
+        offsetof(State, registerD)});                 // mov [rbx + D], r13w
+  emit({0x66, 0x89, 0x43, offsetof(State, pc)});      // mov [rbx + pc], ax
+  emit({0x4c, 0x89, 0x7b, offsetof(State, steps)});   // mov [rbx + steps], r15
+  emit({0x41, 0x5f});                                 // pop r15
+  emit({0x41, 0x5e});                                 // pop r14
+  emit({0x41, 0x5d});                                 // pop r13
+  emit({0x41, 0x5c});                                 // pop r12
+  emit({0x5d});                                       // pop rbp
+  emit({0x5b});                                       // pop rbx
+  emit({0xc3});                                       // ret
+}
+
+void Jit::emitInstruction(Word instruction) {
+  if (IS_A_INSTRUCTION(instruction)) {
+    // mov r12d, instruction
+    emit({0x41, 0xbc});
+    emit32(static_cast<std::uint32_t>(instruction));
+    return;
+  }
+
+  // The ALU control bits are known here, so only the operations they select
+  // are emitted
+  if (USE_REGISTER_M(instruction) || DEST_M(instruction))
+    emit({0x41, 0x0f, 0xb7, 0xcc});                   // movzx ecx, r12w
+
+  if (ZERO_X(instruction))
+    emit({0x31, 0xc0});                               // xor eax, eax
+  else
+    emit({0x44, 0x89, 0xe8});                         // mov eax, r13d
+  if (NEGATE_X(instruction))
+    emit({0xf7, 0xd0});                               // not eax
+
+  if (ZERO_Y(instruction))
+    emit({0x31, 0xd2});                               // xor edx, edx
+  else if (USE_REGISTER_M(instruction))
+    emit({0x41, 0x0f, 0xb7, 0x14, 0x4e});             // movzx edx, [r14 + rcx * 2]
+  else
+    emit({0x44, 0x89, 0xe2});                         // mov edx, r12d
+  if (NEGATE_Y(instruction))
+    emit({0xf7, 0xd2});                               // not edx
+
+  if (ALU_ADD(instruction))
+    emit({0x01, 0xd0});                               // add eax, edx
+  else
+    emit({0x21, 0xd0});                               // and eax, edx
+  if (NEGATE_OUT(instruction))
+    emit({0xf7, 0xd0});                               // not eax
+
+  if (DEST_M(instruction))
+    emit({0x66, 0x41, 0x89, 0x04, 0x4e});             // mov [r14 + rcx * 2], ax
+  if (DEST_A(instruction))
+    emit({0x41, 0x89, 0xc4});                         // mov r12d, eax
+  if (DEST_D(instruction))
+    emit({0x41, 0x89, 0xc5});                         // mov r13d, eax
+}
+
+void Jit::emit(std::initializer_list<std::uint8_t> bytes) {
+  for (auto byte : bytes)
+    code_[codeUsed_++] = byte;
+}
+
+void Jit::emit32(std::uint32_t value) {
+  for (int i = 0; i < 4; ++i)
+    code_[codeUsed_++] = static_cast<std::uint8_t>(value >> (i * 8));
+}
+
+void Jit::emitJump(std::uint8_t *target) {
+  // jmp rel32
+  emit({0xe9});
+  emit32(static_cast<std::uint32_t>(target - (code_ + codeUsed_ + 4)));
+}
+
+void Jit::writable(bool enable) {
+#if HACK_JIT_SUPPORTED
+  mprotect(code_, codeSize_,
+      enable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC));
+#else
+  static_cast<void>(enable);
+#endif
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "hack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define HACK_JIT_SUPPORTED 1
+#else
+#define HACK_JIT_SUPPORTED 0
+#endif
+
+// Compiles the ROM into x86-64 code one basic block at a time. Blocks start at
+// every potential jump target and end after the first instruction with a jump
+// condition; compiled blocks are cached by entry address and chain into each
+// other through a table indexed by pc, so control only returns to C++ when a
+// block has not been compiled yet or the step budget runs out
+class Jit {
+public:
+  Jit();
+  ~Jit();
+  Jit(const Jit &) = delete;
+  Jit& operator=(const Jit &) = delete;
+
+  static bool supported();
+
+  void load(const Word *program);
+  // Runs at most steps instructions and returns the number of steps left, which
+  // is smaller than the next block and has to be executed by the interpreter
+  std::size_t execute(
+      Word *memory, Word &pc, Word &registerA, Word &registerD,
+      std::size_t steps);
+
+private:
+  struct State {
+    void **table;
+    Word *memory;
+    std::uint64_t steps;
+    Word pc;
+    Word registerA;
+    Word registerD;
+  };
+
+  void flush();
+  void compile(std::size_t entry);
+  void emitRuntime();
+  void emitInstruction(Word instruction);
+
+  void emit(std::initializer_list<std::uint8_t> bytes);
+  void emit32(std::uint32_t value);
+  void emitJump(std::uint8_t *target);
+  void writable(bool enable);
+
+  Word program_[ROM_SIZE];
+  std::vector<bool> isTarget_;
+  std::vector<void *> table_;
+  std::uint8_t *code_;
+  std::size_t codeSize_;
+  std::size_t codeUsed_;
+  std::uint8_t *enter_;
+  std::uint8_t *dispatch_;
+  std::uint8_t *leave_;
+};
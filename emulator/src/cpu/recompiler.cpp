@@ -0,0 +1,140 @@
+#include "recompiler.h"
+
+#include <sstream>
+#include <vector>
+
+namespace {
+
+constexpr const char *ALU_FUNCTION_STRINGS[] = {
+  "LOAD_A",
+  "ZERO",
+  "ONE",
+  "MINUS_ONE",
+  "X",
+  "Y",
+  "NOT_X",
+  "NOT_Y",
+  "NEGATE_X",
+  "NEGATE_Y",
+  "X_PLUS_ONE",
+  "Y_PLUS_ONE",
+  "X_MINUS_ONE",
+  "Y_MINUS_ONE",
+  "X_PLUS_Y",
+  "X_MINUS_Y",
+  "Y_MINUS_X",
+  "X_AND_Y",
+  "X_OR_Y",
+  "GENERIC"
+};
+
+void EmitLabel(std::ostream &out, std::size_t address) {
+  out << "L" << address;
+}
+
+} // namespace
+
+std::string Recompile(const Word *program) {
+  // Trailing zeros are never jumped to by a real program; running into them
+  // leaves RunRecompiled and is handled by the interpreter
+  std::size_t size = ROM_SIZE;
+  while (size > 0 && program[size - 1] == 0) --size;
+
+  std::vector<bool> isLeader(size + 1, false);
+  std::vector<std::size_t> leaders;
+  isLeader[0] = true;
+  for (std::size_t i = 0; i < size; ++i) {
+    Word instruction = program[i];
+    if (IS_A_INSTRUCTION(instruction)) {
+      if (static_cast<std::size_t>(instruction) < size)
+        isLeader[static_cast<std::size_t>(instruction)] = true;
+    } else if (JUMP(instruction)) {
+      isLeader[i + 1] = true;
+    }
+  }
+  for (std::size_t i = 0; i < size; ++i)
+    if (isLeader[i]) leaders.push_back(i);
+
+  std::stringstream out;
+  out << "// Generated by HackRecompiler from " << size << " instructions\n"
+      << "#include \"hack.h\"\n\n"
+      << "extern const Word RECOMPILED_PROGRAM[ROM_SIZE] = {";
+  for (std::size_t i = 0; i < size; ++i)
+    out << (i % 8 ? " " : "\n  ") << program[i] << ",";
+  out << "\n};\n\n";
+
+  out << "std::size_t RunRecompiled(\n"
+      << "    Word *memory, Word &pcRef, Word &registerA, Word &registerD,\n"
+      << "    std::size_t steps) {\n"
+      << "  Word pc = pcRef, a = registerA, d = registerD;\n\n"
+      << "dispatch:\n"
+      << "  switch (pc) {\n";
+  for (auto leader : leaders) {
+    out << "    case " << leader << ": goto ";
+    EmitLabel(out, leader);
+    out << ";\n";
+  }
+  out << "    default: goto done;\n"
+      << "  }\n";
+
+  // Whether the value of A is known at this point, so that a jump can go to
+  // its label directly instead of through the switch
+  bool knownA = false;
+  std::size_t valueA = 0;
+  for (std::size_t i = 0; i < size; ++i) {
+    if (isLeader[i]) {
+      std::size_t end = i + 1;
+      while (end < size && !isLeader[end]) ++end;
+
+      out << "\n";
+      EmitLabel(out, i);
+      out << ":\n"
+          << "  if (steps < " << end - i << ") { pc = " << i
+          << "; goto done; }\n"
+          << "  steps -= " << end - i << ";\n";
+      knownA = false;
+    }
+
+    Word instruction = program[i];
+    MicroOp op = Decode(instruction);
+    if (op.alu == AluFunction::LOAD_A) {
+      out << "  a = " << instruction << ";\n";
+      knownA = true;
+      valueA = static_cast<std::size_t>(instruction);
+      continue;
+    }
+
+    if (op.jump) out << "  pc = " << i + 1 << ";\n";
+    out << "  ExecuteC<AluFunction::"
+        << ALU_FUNCTION_STRINGS[static_cast<int>(op.alu)] << ", "
+        << (op.useM ? "true" : "false") << ", "
+        << static_cast<int>(op.dest) << ", "
+        << static_cast<int>(op.jump) << ">(static_cast<Word>("
+        << instruction << "), memory, pc, a, d);\n";
+    if (op.dest & DEST_MASK_A) knownA = false;
+
+    if (op.jump) {
+      if (op.jump != (JUMP_MASK_LT | JUMP_MASK_EQ | JUMP_MASK_GT))
+        out << "  if (pc != " << i + 1 << ") ";
+      else
+        out << "  ";
+      if (knownA && valueA < size) {
+        out << "goto ";
+        EmitLabel(out, valueA);
+        out << ";\n";
+      } else {
+        out << "goto dispatch;\n";
+      }
+    }
+  }
+
+  out << "  pc = " << size << ";\n\n"
+      << "done:\n"
+      << "  pcRef = pc;\n"
+      << "  registerA = a;\n"
+      << "  registerD = d;\n"
+      << "  return steps;\n"
+      << "}\n";
+
+  return out.str();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "hack.h"
+
+#include <string>
+
+// Translates a ROM into a single C++ translation unit that defines
+//
+//   extern const Word RECOMPILED_PROGRAM[ROM_SIZE];
+//   std::size_t RunRecompiled(
+//       Word *memory, Word &pc, Word &registerA, Word &registerD,
+//       std::size_t steps);
+//
+// Every address that can be jumped to becomes a label, jumps to a constant
+// address become gotos and every other jump goes through a dense switch on pc.
+// RunRecompiled follows the same contract as Jit::execute: it returns the
+// number of steps left, which the caller has to execute with the interpreter
+std::string Recompile(const Word *program);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// A bounded lock-free queue for exactly one producer thread and one consumer
+// thread. One slot is kept empty to tell a full queue from an empty one
+template <typename T, std::size_t SIZE>
+class SpscQueue {
+public:
+  SpscQueue() : buffer_(), head_(0), tail_(0) {}
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue& operator=(const SpscQueue &) = delete;
+
+  // Producer only; returns false and drops the value if the queue is full
+  bool push(const T &value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t next = (tail + 1) % SIZE;
+    if (next == head_.load(std::memory_order_acquire)) return false;
+    buffer_[tail] = value;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only; returns false if the queue is empty
+  bool pop(T &value) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    value = buffer_[head];
+    head_.store((head + 1) % SIZE, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, SIZE> buffer_;
+  std::atomic<std::size_t> head_;
+  std::atomic<std::size_t> tail_;
+};
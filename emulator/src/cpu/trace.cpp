@@ -0,0 +1,160 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr char TRACE_MAGIC[4] = {'H', 'T', 'R', 'C'};
+constexpr std::uint8_t TRACE_VERSION = 1;
+
+// Flags of an entry, set for the fields that are not as predicted
+constexpr std::uint8_t FLAG_PC = 1 << 0;
+constexpr std::uint8_t FLAG_A = 1 << 1;
+constexpr std::uint8_t FLAG_D = 1 << 2;
+constexpr std::uint8_t FLAG_WROTE = 1 << 3;
+constexpr std::uint8_t FLAG_ADDRESS = 1 << 4;
+constexpr std::uint8_t FLAG_VALUE = 1 << 5;
+
+void WriteVarint(std::ostream &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.put(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.put(static_cast<char>(value));
+}
+
+std::uint64_t ReadVarint(std::istream &in) {
+  std::uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = in.get();
+    if (byte == std::char_traits<char>::eof())
+      throw std::runtime_error("Trace ends in the middle of an entry");
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return value;
+  }
+  throw std::runtime_error("Trace has a malformed varint");
+}
+
+// Deltas wrap around like the 16-bit registers, and small ones of either sign
+// take a single byte
+void WriteDelta(std::ostream &out, Word from, Word to) {
+  auto delta = static_cast<std::int16_t>(
+      static_cast<std::uint16_t>(to) - static_cast<std::uint16_t>(from));
+  auto zigzag = static_cast<std::uint16_t>(
+      (static_cast<std::uint16_t>(delta) << 1) ^ (delta < 0 ? 0xffff : 0));
+  WriteVarint(out, zigzag);
+}
+
+Word ReadDelta(std::istream &in, Word from) {
+  auto zigzag = static_cast<std::uint16_t>(ReadVarint(in));
+  auto delta = static_cast<std::uint16_t>(
+      (zigzag >> 1) ^ ((zigzag & 1) ? 0xffff : 0));
+  return static_cast<Word>(static_cast<std::uint16_t>(from) + delta);
+}
+
+} // namespace
+
+TraceBuffer::TraceBuffer(std::size_t capacity) :
+  entries_(capacity),
+  next_(0),
+  size_(0)
+{
+
+}
+
+void TraceBuffer::setCapacity(std::size_t capacity) {
+  entries_.assign(capacity, TraceEntry{});
+  clear();
+}
+
+void TraceBuffer::clear() {
+  next_ = size_ = 0;
+}
+
+std::size_t TraceBuffer::capacity() const {
+  return entries_.size();
+}
+
+std::size_t TraceBuffer::size() const {
+  return size_;
+}
+
+const TraceEntry &TraceBuffer::operator[](std::size_t i) const {
+  std::size_t index = next_ + entries_.size() - size_ + i;
+  return entries_[index % entries_.size()];
+}
+
+void TraceBuffer::write(std::ostream &out, std::size_t count) const {
+  count = std::min(count, size_);
+  out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+  out.put(static_cast<char>(TRACE_VERSION));
+  WriteVarint(out, count);
+
+  TraceEntry last{-1, 0, 0, false, 0, 0};
+  for (std::size_t i = size_ - count; i < size_; ++i) {
+    const TraceEntry &entry = (*this)[i];
+    // A C-instruction writes M before it changes A, so the address to expect
+    // is the A of the entry before
+    auto expectedAddress = static_cast<std::uint16_t>(last.a);
+    std::uint8_t flags = 0;
+    if (entry.pc != static_cast<Word>(last.pc + 1)) flags |= FLAG_PC;
+    if (entry.a != last.a) flags |= FLAG_A;
+    if (entry.d != last.d) flags |= FLAG_D;
+    if (entry.wrote) {
+      flags |= FLAG_WROTE;
+      if (entry.address != expectedAddress) flags |= FLAG_ADDRESS;
+      if (entry.value != entry.d) flags |= FLAG_VALUE;
+    }
+
+    out.put(static_cast<char>(flags));
+    if (flags & FLAG_PC)
+      WriteDelta(out, static_cast<Word>(last.pc + 1), entry.pc);
+    if (flags & FLAG_A) WriteDelta(out, last.a, entry.a);
+    if (flags & FLAG_D) WriteDelta(out, last.d, entry.d);
+    if (flags & FLAG_ADDRESS) {
+      WriteDelta(out, static_cast<Word>(expectedAddress),
+                 static_cast<Word>(entry.address));
+    }
+    if (flags & FLAG_VALUE) WriteDelta(out, entry.d, entry.value);
+    last = entry;
+  }
+}
+
+std::vector<TraceEntry> ReadTrace(std::istream &in) {
+  char magic[sizeof(TRACE_MAGIC)];
+  if (!in.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), TRACE_MAGIC))
+    throw std::runtime_error("Not a Hack trace file");
+  if (in.get() != TRACE_VERSION)
+    throw std::runtime_error("Unsupported Hack trace version");
+
+  std::uint64_t count = ReadVarint(in);
+  std::vector<TraceEntry> entries;
+  TraceEntry last{-1, 0, 0, false, 0, 0};
+  for (std::uint64_t i = 0; i < count; ++i) {
+    int flags = in.get();
+    if (flags == std::char_traits<char>::eof())
+      throw std::runtime_error("Trace ends before its last entry");
+
+    TraceEntry entry{static_cast<Word>(last.pc + 1), last.a, last.d, false,
+                     static_cast<std::uint16_t>(last.a), 0};
+    if (flags & FLAG_PC) entry.pc = ReadDelta(in, entry.pc);
+    if (flags & FLAG_A) entry.a = ReadDelta(in, last.a);
+    if (flags & FLAG_D) entry.d = ReadDelta(in, last.d);
+    if (flags & FLAG_WROTE) {
+      entry.wrote = true;
+      if (flags & FLAG_ADDRESS) {
+        entry.address = static_cast<std::uint16_t>(
+            ReadDelta(in, static_cast<Word>(entry.address)));
+      }
+      entry.value = entry.d;
+      if (flags & FLAG_VALUE) entry.value = ReadDelta(in, entry.d);
+    } else {
+      entry.address = 0;
+    }
+    entries.push_back(entry);
+    last = entry;
+  }
+  return entries;
+}
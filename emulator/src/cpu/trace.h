@@ -0,0 +1,58 @@
+#pragma once
+
+#include "hack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// One executed instruction: its address, A and D after it, and the word it
+// wrote to RAM, if any
+struct TraceEntry {
+  Word pc;
+  Word a;
+  Word d;
+  bool wrote;
+  std::uint16_t address;
+  Word value;
+};
+
+// Keeps the last capacity() executed instructions, overwriting the oldest one
+// once full, so that tracing a long run costs a fixed amount of memory
+class TraceBuffer {
+public:
+  explicit TraceBuffer(std::size_t capacity = 0);
+
+  // Also clears the buffer
+  void setCapacity(std::size_t capacity);
+  void clear();
+  void record(const TraceEntry &entry) {
+    if (entries_.empty()) return;
+    entries_[next_] = entry;
+    if (++next_ == entries_.size()) next_ = 0;
+    if (size_ < entries_.size()) ++size_;
+  }
+
+  std::size_t capacity() const;
+  std::size_t size() const;
+  // The i-th oldest entry still in the buffer
+  const TraceEntry &operator[](std::size_t i) const;
+
+  // Writes the last count entries, oldest first, in the binary trace format:
+  // the magic "HTRC", a format version byte and the number of entries as a
+  // varint, then per entry a byte of flags followed by zigzag varint deltas of
+  // the fields that are not what the previous entry predicts (pc + 1, the same
+  // A and D, a write to the old A of the value in D)
+  void write(std::ostream &out, std::size_t count) const;
+
+private:
+  std::vector<TraceEntry> entries_;
+  std::size_t next_;
+  std::size_t size_;
+};
+
+// Reads a trace written by TraceBuffer::write; throws std::runtime_error if it
+// is not one
+std::vector<TraceEntry> ReadTrace(std::istream &in);
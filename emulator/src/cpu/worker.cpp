@@ -0,0 +1,156 @@
+#include "worker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// Wall time the worker runs the CPU for before publishing a snapshot
+constexpr std::chrono::microseconds SLICE_BUDGET(4000);
+// How long the worker sleeps when the program is idle or halted, i.e. the
+// worst-case delay before it notices a key
+constexpr std::chrono::microseconds IDLE_SLEEP(1000);
+
+} // namespace
+
+Worker::Worker(Cpu &cpu) :
+  cpu_(cpu),
+  thread_(),
+  stopping_(false),
+  finished_(false),
+  speed_(std::numeric_limits<double>::infinity()),
+  keys_(),
+  lastKeyCycle_(0),
+  stoppedCycle_(0),
+  snapshots_(),
+  middle_(1),
+  back_(0),
+  front_(2),
+  shown_(),
+  changes_(0)
+{
+
+}
+
+Worker::~Worker() {
+  stop();
+}
+
+void Worker::start() {
+  if (running()) return;
+
+  // Whatever the display shows now has to be repainted from the first snapshot
+  Word key;
+  while (keys_.pop(key)) {}
+  lastKeyCycle_ = 0;
+  for (auto &snapshot : snapshots_) snapshot = Snapshot();
+  middle_.store(1, std::memory_order_relaxed);
+  back_ = 0;
+  front_ = 2;
+  changes_ = (1 << DISPLAY_SIZE) - 1;
+  launch();
+}
+
+void Worker::stop() {
+  if (!thread_.joinable()) return;
+  stopping_.store(true, std::memory_order_release);
+  thread_.join();
+}
+
+void Worker::resume() {
+  if (running()) return;
+
+  // Keys are only spaced out on the timeline they were queued on
+  if (cpu_.cycles() != stoppedCycle_) lastKeyCycle_ = 0;
+  launch();
+}
+
+bool Worker::running() const {
+  return thread_.joinable() && !finished_.load(std::memory_order_acquire);
+}
+
+void Worker::setSpeed(double instructionsPerSecond) {
+  speed_.store(instructionsPerSecond, std::memory_order_relaxed);
+}
+
+bool Worker::pushKey(Word key) {
+  return keys_.push(key);
+}
+
+std::uint16_t Worker::update() {
+  if (middle_.load(std::memory_order_relaxed) & FRESH)
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & ~FRESH;
+
+  const auto &display = snapshots_[static_cast<std::size_t>(front_)].display;
+  std::uint16_t changes = changes_;
+  for (std::size_t i = 0; i < DISPLAY_SIZE; ++i) {
+    if (shown_[i] != display[i]) {
+      shown_[i] = display[i];
+      changes |= static_cast<std::uint16_t>(1 << i);
+    }
+  }
+  changes_ = 0;
+  return changes;
+}
+
+const Worker::Snapshot &Worker::snapshot() const {
+  return snapshots_[static_cast<std::size_t>(front_)];
+}
+
+void Worker::launch() {
+  // A thread that halted on a fault is done but still has to be joined
+  if (thread_.joinable()) thread_.join();
+  stopping_.store(false, std::memory_order_relaxed);
+  finished_.store(false, std::memory_order_relaxed);
+  thread_ = std::thread(&Worker::run, this);
+}
+
+void Worker::run() {
+  while (!stopping_.load(std::memory_order_acquire)) {
+    // Holding a key costs nothing once the program is idle waiting for the
+    // next one, as the CPU skips ahead to it
+    Word key;
+    while (keys_.pop(key)) {
+      lastKeyCycle_ = std::max(cpu_.cycles(), lastKeyCycle_ + KEY_HOLD_CYCLES);
+      cpu_.queueKey(key, lastKeyCycle_);
+    }
+
+    // A slice that reaches the speed cap early sleeps for the rest of its time
+    auto sliceEnd = std::chrono::steady_clock::now() + SLICE_BUDGET;
+    double speedSteps = speed_.load(std::memory_order_relaxed) *
+        std::chrono::duration<double>(SLICE_BUDGET).count();
+    std::size_t maxSteps = std::numeric_limits<std::size_t>::max();
+    if (speedSteps < static_cast<double>(maxSteps))
+      maxSteps = static_cast<std::size_t>(speedSteps);
+    Cpu::Status status;
+    try {
+      status = cpu_.executeFor(SLICE_BUDGET, maxSteps);
+    } catch (const std::exception &e) {
+      // A fault under the checked policy halts the program
+      std::cerr << e.what() << "\n";
+      publish(Cpu::Status::HALTED);
+      stoppedCycle_ = cpu_.cycles();
+      finished_.store(true, std::memory_order_release);
+      return;
+    }
+    publish(status);
+    if (status != Cpu::Status::RUNNING)
+      std::this_thread::sleep_for(IDLE_SLEEP);
+    else
+      std::this_thread::sleep_until(sliceEnd);
+  }
+  stoppedCycle_ = cpu_.cycles();
+}
+
+void Worker::publish(Cpu::Status status) {
+  auto &snapshot = snapshots_[static_cast<std::size_t>(back_)];
+  const Word *memory = cpu_.memory();
+  for (std::size_t i = 0; i < DISPLAY_SIZE; ++i)
+    snapshot.display[i] = memory[static_cast<std::size_t>(DISPLAY) + i];
+  snapshot.status = status;
+  snapshot.instructionsPerSecond = cpu_.instructionsPerSecond();
+  back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
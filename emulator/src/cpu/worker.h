@@ -0,0 +1,78 @@
+#pragma once
+
+#include "cpu.h"
+#include "hack.h"
+#include "spscqueue.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Runs a Cpu on its own thread, so that emulation does not wait for rendering
+// and the other way round. While it runs, the render thread must not touch the
+// Cpu; it pushes keys through a lock-free queue and reads the display from
+// snapshots that the worker publishes after every time slice. The snapshots
+// are triple buffered, so neither side ever waits for the other
+class Worker {
+public:
+  struct Snapshot {
+    std::array<Word, DISPLAY_SIZE> display;
+    Cpu::Status status;
+    double instructionsPerSecond;
+  };
+
+  explicit Worker(Cpu &cpu);
+  ~Worker();
+  Worker(const Worker &) = delete;
+  Worker& operator=(const Worker &) = delete;
+
+  void start();
+  void stop();
+  // Starts again after stop without a fresh start: keys that have not reached
+  // the CPU yet are kept, and so is the snapshot on show until the next one.
+  // For pausing the worker while the render thread works on the Cpu
+  void resume();
+  // False once the program faults, even before stop is called
+  bool running() const;
+
+  // Caps the emulation speed, in instructions per second
+  void setSpeed(double instructionsPerSecond);
+  // Render thread only; returns false if the key was dropped. Keys reach the
+  // program in order and each is held for at least KEY_HOLD_CYCLES, so that
+  // none is missed however fast they come
+  bool pushKey(Word key);
+  // Render thread only: picks up the newest snapshot and returns a bitmask of
+  // the digits that differ from the previous one, like Cpu::takeDisplayChanges
+  std::uint16_t update();
+  const Snapshot &snapshot() const;
+
+private:
+  static constexpr std::size_t KEY_QUEUE_SIZE = 64;
+  static constexpr std::uint64_t KEY_HOLD_CYCLES = 1 << 22;
+  // Set in middle_ when it holds a snapshot the render thread has not seen
+  static constexpr int FRESH = 4;
+
+  void launch();
+  void run();
+  void publish(Cpu::Status status);
+
+  Cpu &cpu_;
+  std::thread thread_;
+  std::atomic<bool> stopping_;
+  // Set by the thread when it leaves run on its own, after a fault
+  std::atomic<bool> finished_;
+  std::atomic<double> speed_;
+  SpscQueue<Word, KEY_QUEUE_SIZE> keys_;
+  std::uint64_t lastKeyCycle_;
+  // cycles() when the thread last left run, to tell whether a state was
+  // loaded since
+  std::uint64_t stoppedCycle_;
+
+  std::array<Snapshot, 3> snapshots_;
+  std::atomic<int> middle_;
+  int back_;
+  int front_;
+  std::array<Word, DISPLAY_SIZE> shown_;
+  std::uint16_t changes_;
+};
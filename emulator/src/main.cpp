@@ -3,37 +3,20 @@
 #include "compiler/vmcommand.h"
 #include "translator/translator.h"
 #include "assembler/assembler.h"
+#include "cpu/hack.h"
+#include "cpu/cpu.h"
+#include "cpu/worker.h"
 
 #include <string>
 #include <exception>
 #include <iostream>
 #include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
 #include <emscripten.h>
 
-using Word = int16_t;
-constexpr int WORD_WIDTH = 16;
-
-#define IS_A_INSTRUCTION(instruction)   ~(((instruction) >> (WORD_WIDTH - 1)))
-#define IS_C_INSTRUCTION(instruction)   ((instruction) >> (WORD_WIDTH - 1))
-
-
-#define USE_REGISTER_M(instruction)     (((instruction) >> 12) & 1)
-
-#define ZERO_X(instruction)             (((instruction) >> 11) & 1)
-#define NEGATE_X(instruction)           (((instruction) >> 10) & 1)
-#define ZERO_Y(instruction)             (((instruction) >>  9) & 1)
-#define NEGATE_Y(instruction)           (((instruction) >>  8) & 1)
-#define ALU_ADD(instruction)            (((instruction) >>  7) & 1)
-#define NEGATE_OUT(instruction)         (((instruction) >>  6) & 1)
-
-#define DEST_A(instruction)             (((instruction) >>  5) & 1)
-#define DEST_D(instruction)             (((instruction) >>  4) & 1)
-#define DEST_M(instruction)             (((instruction) >>  3) & 1)
-
-#define JLT(instruction)                (((instruction) >>  2) & 1)
-#define JEQ(instruction)                (((instruction) >>  1) & 1)
-#define JGT(instruction)                (((instruction)      ) & 1)
-
 class Timer {
 public:
   Timer(std::string msg) :
@@ -52,19 +35,17 @@ private:
 };
 
 extern "C" {
-  constexpr size_t ROM_SIZE = 32768;
-  constexpr Word KBD = 16397;
-
   VMCommands vmCommands;
   std::unordered_map<std::string, std::string> vmCodeStrings;
   std::string assemblyString; 
 
   Translator translator;
   Word program[ROM_SIZE];
-  Word *memory;
-  Word pc, registerA, registerD;
+  Cpu cpu;
+  Worker worker(cpu);
+  std::unordered_map<int, Cpu::State> states;
+  int nextStateId = 0;
 
-  void Init();
   size_t CompileFile(char *inputFileName, char *input, int length);
   void GetVmCodeString(char *inputFileName, char *vmCodeStringBuffer);
   void TranslateFile(char *inputFileName);
@@ -74,15 +55,27 @@ extern "C" {
   void GetMachineCode(char *machineCodeBuffer, int idx);
   void SetMemoryPtr(Word *ptr);
   bool InitializeExecution();
-  bool Execute(std::size_t steps);
+  int Execute(std::size_t steps);
+  int ExecuteFor(int microseconds, std::size_t maxSteps);
+  double GetInstructionsPerSecond();
+  void StartWorker();
+  void StopWorker();
+  void SetWorkerSpeed(double instructionsPerSecond);
+  bool PushKey(Word key);
+  int UpdateWorker();
+  const Word *GetWorkerDisplay();
+  int GetWorkerStatus();
+  double GetWorkerInstructionsPerSecond();
+  int TakeDisplayChanges();
+  void SetDispatchMode(int mode);
+  void SetPolicy(int policy);
   void SetKey(Word key);
+  int SaveState();
+  bool LoadState(int id);
+  void FreeState(int id);
   void Reset();
   void Clear();
 
-  void Init() {
-    Assembler::initialize();
-  }
-
   size_t CompileFile(char *inputFileName, char *inputArray, int length) {
     try {
       std::string input(inputArray, inputArray + length);
@@ -134,31 +127,24 @@ extern "C" {
   }
 
   void Assemble() {
-    // DEBUG
-    std::string machineCodeString;
-    {
+    std::vector<Word> machineCode;
+    try {
       Timer timer("Assemble");
-      machineCodeString = Assembler::assemble(assemblyString);
+      machineCode = Assembler::assemble(assemblyString);
+      if (machineCode.size() > ROM_SIZE)
+        throw std::runtime_error("Program does not fit into the ROM");
+    } catch (const std::exception &e) {
+      std::cout << e.what() << "\n";
+      return;
     }
 
-    // DEBUG
-    {
-      Timer timer("Conversion");
-      memset(program, 0, sizeof(program));
-      int idx = 0;
-      for (size_t i = 0; i < machineCodeString.length(); i += WORD_WIDTH + 1) {
-        for (size_t j = 0; j < WORD_WIDTH; ++j) {
-          program[idx] |=
-              static_cast<Word>(machineCodeString[i + j] - '0') <<
-              (WORD_WIDTH - 1 - j);
-        }
-        ++idx;
-      }
-    }
+    memset(program, 0, sizeof(program));
+    std::copy(machineCode.begin(), machineCode.end(), program);
+    cpu.load(program);
 
     EM_ASM(console.log(
         'Assembled program, contains ' + UTF8ToString($0) + ' instructions');,
-        std::to_string(machineCodeString.length() / WORD_WIDTH).c_str());
+        std::to_string(machineCode.size()).c_str());
   }
 
   void GetMachineCode(char *machineCodeBuffer, int idx) {
@@ -168,55 +154,123 @@ extern "C" {
   }
 
   void SetMemoryPtr(Word *ptr) {
-    memory = ptr;
+    cpu.setMemoryPtr(ptr);
   }
 
   bool InitializeExecution() {
-    pc = 0;
+    cpu.reset();
     return true;
   }
 
-  bool Execute(std::size_t steps) {
-    for (std::size_t step = 0; step < steps; ++step) {
-      Word instruction = program[pc++];
-      if (IS_A_INSTRUCTION(instruction)) {
-        registerA = instruction;
-      } else {
-        Word x = registerD;
-        Word y = USE_REGISTER_M(instruction) ?
-                 memory[registerA & 0xffff] :
-                 registerA;
-        x = ~(-  ZERO_X(instruction)) & x;
-        x =  (-NEGATE_X(instruction)) ^ x;
-        y = ~(-  ZERO_Y(instruction)) & y;
-        y =  (-NEGATE_Y(instruction)) ^ y;
-        Word result = ALU_ADD(instruction) ? (x + y) : (x & y);
-        result = (-NEGATE_OUT(instruction)) ^ result;
-
-        if (DEST_M(instruction)) memory[registerA & 0xffff] = result;
-        if (DEST_A(instruction)) registerA = result;
-        if (DEST_D(instruction)) registerD = result;
-
-        int16_t result16 = static_cast<int16_t>(result & 0xffff);
-        bool jump = (JLT(instruction) && result16 <  0) ||
-                    (JEQ(instruction) && result16 == 0) ||
-                    (JGT(instruction) && result16 >  0);
-        if (jump) pc = registerA;
-      }
+  int Execute(std::size_t steps) {
+    try {
+      return static_cast<int>(cpu.execute(steps));
+    } catch (const std::exception &e) {
+      std::cout << e.what() << "\n";
+      return static_cast<int>(Cpu::Status::HALTED);
     }
+  }
+
+  int ExecuteFor(int microseconds, std::size_t maxSteps) {
+    try {
+      return static_cast<int>(
+          cpu.executeFor(std::chrono::microseconds(microseconds), maxSteps));
+    } catch (const std::exception &e) {
+      std::cout << e.what() << "\n";
+      return static_cast<int>(Cpu::Status::HALTED);
+    }
+  }
+
+  double GetInstructionsPerSecond() {
+    return cpu.instructionsPerSecond();
+  }
+
+  // The worker owns the CPU from StartWorker to StopWorker; in between only
+  // the functions below may be used to talk to it
+  void StartWorker() {
+    worker.start();
+  }
 
-    return false;
+  void StopWorker() {
+    worker.stop();
+  }
+
+  void SetWorkerSpeed(double instructionsPerSecond) {
+    worker.setSpeed(instructionsPerSecond);
+  }
+
+  bool PushKey(Word key) {
+    return worker.pushKey(key);
+  }
+
+  int UpdateWorker() {
+    return worker.update();
+  }
+
+  const Word *GetWorkerDisplay() {
+    return worker.snapshot().display.data();
+  }
+
+  int GetWorkerStatus() {
+    return static_cast<int>(worker.snapshot().status);
+  }
+
+  double GetWorkerInstructionsPerSecond() {
+    return worker.snapshot().instructionsPerSecond;
+  }
+
+  int TakeDisplayChanges() {
+    return cpu.takeDisplayChanges();
+  }
+
+  void SetDispatchMode(int mode) {
+    cpu.setDispatchMode(static_cast<Cpu::DispatchMode>(mode));
+    EM_ASM_({
+      console.log('Dispatch mode set to ' + $0);
+    }, mode);
+  }
+
+  void SetPolicy(int policy) {
+    cpu.setPolicy(static_cast<Cpu::Policy>(policy));
   }
 
   void SetKey(Word key) {
     // DEBUG
     // std::cout << "key: " << key << "\n";
 
-    memory[KBD] = key;
+    cpu.setKey(key);
+  }
+
+  // States are kept by id until freed; they share unchanged RAM pages, so
+  // keeping many of them that fork from the same state is cheap. A running
+  // worker is paused for the copy and then carries on from the result, with
+  // the keys still on their way to it
+  int SaveState() {
+    bool running = worker.running();
+    worker.stop();
+    states.emplace(nextStateId, cpu.saveState());
+    if (running) worker.resume();
+    return nextStateId++;
+  }
+
+  bool LoadState(int id) {
+    auto it = states.find(id);
+    if (it == states.end()) return false;
+    bool running = worker.running();
+    worker.stop();
+    cpu.loadState(it->second);
+    std::copy(cpu.program(), cpu.program() + ROM_SIZE, program);
+    if (running) worker.resume();
+    return true;
+  }
+
+  void FreeState(int id) {
+    states.erase(id);
   }
 
   void Reset() {
-    pc = 0;
+    worker.stop();
+    cpu.reset();
   }
 
   void Clear() {
@@ -0,0 +1,111 @@
+#include "assembler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+
+namespace {
+
+constexpr std::size_t DEFAULT_LINES = 1000000;
+constexpr int DEFAULT_RUNS = 5;
+
+const char *const C_INSTRUCTIONS[] = {
+  "AM=M-1", "D=M", "A=A-1", "M=D+M", "M=M-D", "D=A", "M=D",
+  "D;JEQ", "0;JMP", "M=-1", "A=M", "MD=M+1", "D=D-A", "D;JGT"
+};
+
+void PrintUsage(const char *name) {
+  std::cerr << "Usage: " << name << " [--lines <count>] [--runs <count>]\n";
+}
+
+// Assembly that looks like what the translator writes: predefined symbols,
+// static variables, labels jumped to from before and after their definition,
+// C-instructions with and without jumps, and the odd comment
+std::string GenerateAssembly(std::size_t lines) {
+  std::mt19937 random(1);
+  std::string assembly;
+  std::size_t labels = 0;
+  for (std::size_t line = 0; line < lines; ++line) {
+    switch (random() % 16) {
+      case 0:
+        assembly += "(Main.loop$L" + std::to_string(labels++) + ")\n";
+        break;
+      case 1:
+        assembly += "@Main.loop$L" + std::to_string(
+            labels + random() % 64 - std::min<std::size_t>(labels, 32)) + "\n";
+        break;
+      case 2:
+        assembly += "@Main." + std::to_string(random() % 32) + "\n";
+        break;
+      case 3:
+        assembly += "// push constant\n";
+        break;
+      case 4:
+      case 5:
+        assembly += "@SP\n";
+        break;
+      case 6:
+        assembly += "@" + std::to_string(random() % 32768) + "\n";
+        break;
+      default:
+        assembly += C_INSTRUCTIONS[random() % std::size(C_INSTRUCTIONS)];
+        assembly += "\n";
+        break;
+    }
+  }
+  return assembly;
+}
+
+} // namespace
+
+// Assembles a synthetic program a few times and prints the best throughput
+int main(int argc, char **argv) {
+  std::size_t lines = DEFAULT_LINES;
+  int runs = DEFAULT_RUNS;
+  int arg = 1;
+  while (arg + 1 < argc && std::strncmp(argv[arg], "--", 2) == 0) {
+    std::string option = argv[arg], value = argv[arg + 1];
+    bool isNumber = !value.empty() &&
+        value.find_first_not_of("0123456789") == std::string::npos;
+    if (option == "--lines" && isNumber) {
+      lines = std::stoull(value);
+    } else if (option == "--runs" && isNumber) {
+      runs = std::stoi(value);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (arg != argc || runs < 1) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::string assembly = GenerateAssembly(lines);
+  double best = 0;
+  std::size_t instructions = 0;
+  try {
+    for (int run = 0; run < runs; ++run) {
+      auto start = std::chrono::steady_clock::now();
+      instructions = Assembler::assemble(assembly).size();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      if (run == 0 || elapsed.count() < best) best = elapsed.count();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout << lines << " lines, " << instructions << " instructions: "
+            << best << " seconds, "
+            << static_cast<double>(lines) / best / 1e6 << " million lines/s, "
+            << static_cast<double>(assembly.size()) / best / 1e6 << " MB/s\n";
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "batch.h"
+#include "cpu.h"
+#include "script.h"
+#include "toolchain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t DEFAULT_LANES = 256;
+
+void PrintUsage(const char *name) {
+  std::cerr << "Usage: " << name
+            << " [--lanes <count>] <keys.txt> <file.jack>...\n";
+}
+
+// Lane i plays the key script with every digit shifted by i, so that the
+// lanes run the same program on different inputs
+Word LaneKey(Word key, std::size_t lane) {
+  if (key < 0 || key > 9) return key;
+  return static_cast<Word>((static_cast<std::size_t>(key) + lane) % 10);
+}
+
+} // namespace
+
+// Runs the key script on every lane with BatchCpu, then once per lane with
+// Cpu, and prints the time and the throughput of both. Exits with an error if
+// any lane ends up with a different display
+int main(int argc, char **argv) {
+  std::size_t lanes = DEFAULT_LANES;
+  int arg = 1;
+  while (arg + 1 < argc && std::strncmp(argv[arg], "--", 2) == 0) {
+    std::string option = argv[arg], value = argv[arg + 1];
+    if (option == "--lanes" && !value.empty() &&
+        value.find_first_not_of("0123456789") == std::string::npos) {
+      lanes = std::stoull(value);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (argc - arg < 2 || lanes == 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<KeyPress> keyPresses;
+  std::vector<Word> program;
+  try {
+    keyPresses = LoadKeyScript(argv[arg]);
+    program = BuildRom(std::vector<std::string>(argv + arg + 1, argv + argc));
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  std::size_t cycles = 0;
+  for (const auto &keyPress : keyPresses) cycles += keyPress.steps;
+  double instructions = static_cast<double>(cycles * lanes);
+  using Clock = std::chrono::steady_clock;
+
+  auto batch = std::make_unique<BatchCpu>(lanes);
+  batch->load(program.data());
+  auto start = Clock::now();
+  for (const auto &keyPress : keyPresses) {
+    for (std::size_t lane = 0; lane < lanes; ++lane)
+      batch->setKey(lane, LaneKey(keyPress.key, lane));
+    batch->execute(keyPress.steps);
+  }
+  std::chrono::duration<double> batchTime = Clock::now() - start;
+  std::cout << "batch: " << batchTime.count() << " seconds, "
+            << instructions / batchTime.count() / 1e6 << " MIPS, "
+            << batch->groups() << " groups at the end\n";
+
+  // Independent runs skip the time the program spends idle, as HackEmulatorCli
+  // runs them, while the lanes run every cycle. The throughput only counts the
+  // instructions a Cpu actually executed, so both are rated on the same work
+  std::vector<Word> memory(1 << WORD_WIDTH, 0);
+  auto cpu = std::make_unique<Cpu>();
+  cpu->load(program.data());
+  cpu->setMemoryPtr(memory.data());
+  std::size_t mismatches = 0;
+  std::uint64_t idleCycles = 0;
+  std::chrono::duration<double> cpuTime(0);
+  for (std::size_t lane = 0; lane < lanes; ++lane) {
+    std::fill(memory.begin(), memory.end(), 0);
+    cpu->reset();
+    std::size_t cycle = 0;
+    for (const auto &keyPress : keyPresses) {
+      cpu->queueKey(LaneKey(keyPress.key, lane), cycle);
+      cycle += keyPress.steps;
+    }
+    start = Clock::now();
+    cpu->execute(cycles);
+    cpuTime += Clock::now() - start;
+    idleCycles += cpu->idleCycles();
+
+    for (std::size_t i = 0; i < DISPLAY_SIZE; ++i) {
+      auto address = static_cast<std::uint16_t>(DISPLAY + i);
+      if (batch->memory(lane, address) != memory[address]) {
+        ++mismatches;
+        break;
+      }
+    }
+  }
+  double executed = instructions - static_cast<double>(idleCycles);
+  std::cout << "independent: " << cpuTime.count() << " seconds, "
+            << executed / cpuTime.count() / 1e6 << " MIPS, "
+            << 100 * (1 - executed / instructions)
+            << "% of the cycles skipped while idle\n";
+
+  if (mismatches) {
+    std::cerr << mismatches << " of " << lanes
+              << " lanes end with a different display\n";
+    return 1;
+  }
+  return 0;
+}
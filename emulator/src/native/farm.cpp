@@ -0,0 +1,162 @@
+#include "cpu.h"
+#include "report.h"
+#include "script.h"
+#include "threadpool.h"
+#include "toolchain.h"
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A key script and the report HackEmulatorCli printed for it
+struct Job {
+  std::string name;
+  std::vector<KeyPress> keyPresses;
+  std::string expected;
+};
+
+// What every thread runs its jobs on
+struct Instance {
+  Instance() : cpu(), memory() {}
+
+  std::unique_ptr<Cpu> cpu;
+  std::vector<Word> memory;
+};
+
+void PrintUsage(const char *name) {
+  std::cerr << "Usage: " << name
+            << " [--threads <count>] <suite.txt> <file.jack>...\n";
+}
+
+std::string ReadFile(const std::filesystem::path &path) {
+  std::ifstream inputFile(path);
+  if (!inputFile)
+    throw std::runtime_error("Cannot open " + path.string());
+  std::stringstream contents;
+  contents << inputFile.rdbuf();
+  return contents.str();
+}
+
+// Each line of a suite is a key script followed by the file with its expected
+// output, both relative to the suite. Empty lines and lines starting with '#'
+// are ignored
+std::vector<Job> LoadSuite(const std::string &fileName) {
+  std::ifstream inputFile(fileName);
+  if (!inputFile)
+    throw std::runtime_error("Cannot open " + fileName);
+
+  auto directory = std::filesystem::path(fileName).parent_path();
+  std::vector<Job> jobs;
+  std::string line;
+  std::size_t lineNumber = 0;
+  while (std::getline(inputFile, line)) {
+    ++lineNumber;
+    std::stringstream input(line);
+    std::string keys, expected;
+    if (!(input >> keys) || keys.front() == '#') continue;
+    if (!(input >> expected))
+      throw std::runtime_error("Line " + std::to_string(lineNumber) +
+          ": expected an output file after the key script");
+    jobs.push_back({keys, LoadKeyScript((directory / keys).string()),
+                    ReadFile(directory / expected)});
+  }
+  return jobs;
+}
+
+// Runs the job the same way HackEmulatorCli does and returns its report
+std::string RunJob(Instance &instance, const Job &job) {
+  std::fill(instance.memory.begin(), instance.memory.end(), 0);
+  Cpu &cpu = *instance.cpu;
+  cpu.reset();
+  std::size_t cycles = 0;
+  for (const auto &keyPress : job.keyPresses) {
+    cpu.queueKey(keyPress.key, cycles);
+    cycles += keyPress.steps;
+  }
+  cpu.execute(cycles);
+
+  std::ostringstream report;
+  PrintReport(report, instance.memory.data(), cycles);
+  return report.str();
+}
+
+} // namespace
+
+// Runs every key script of the suite on its own CPU, spread over all cores,
+// and prints the ones whose output differs from the expected one
+int main(int argc, char **argv) {
+  std::size_t threads = 0;
+  int arg = 1;
+  while (arg + 1 < argc && std::strncmp(argv[arg], "--", 2) == 0) {
+    std::string option = argv[arg], value = argv[arg + 1];
+    if (option == "--threads" && !value.empty() &&
+        value.find_first_not_of("0123456789") == std::string::npos) {
+      threads = std::stoull(value);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (argc - arg < 2) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<Job> jobs;
+  std::vector<Word> program;
+  try {
+    jobs = LoadSuite(argv[arg]);
+    program = BuildRom(std::vector<std::string>(argv + arg + 1, argv + argc));
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  WorkStealingPool pool(threads);
+  // Created by the thread that uses it, so that its RAM is allocated close to
+  // where it runs
+  std::vector<Instance> instances(pool.threads());
+  std::vector<std::string> failures(jobs.size());
+  auto start = std::chrono::steady_clock::now();
+  pool.run(jobs.size(), [&](std::size_t job, std::size_t thread) {
+    Instance &instance = instances[thread];
+    try {
+      if (!instance.cpu) {
+        instance.memory.assign(1 << WORD_WIDTH, 0);
+        instance.cpu = std::make_unique<Cpu>();
+        instance.cpu->load(program.data());
+        instance.cpu->setMemoryPtr(instance.memory.data());
+      }
+      std::string output = RunJob(instance, jobs[job]);
+      if (output != jobs[job].expected) {
+        failures[job] = "expected\n" + jobs[job].expected + "got\n" + output;
+      }
+    } catch (const std::exception &e) {
+      failures[job] = e.what() + std::string("\n");
+    }
+  });
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::size_t failed = 0;
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    if (failures[i].empty()) continue;
+    ++failed;
+    std::cout << "FAIL " << jobs[i].name << ":\n" << failures[i];
+  }
+  std::cout << jobs.size() - failed << " passed, " << failed << " failed\n";
+  std::cerr << "time: " << elapsed.count() << " seconds on " << pool.threads()
+            << " threads\n";
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+#include "cpu.h"
+#include "profile.h"
+#include "report.h"
+#include "script.h"
+#include "toolchain.h"
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t DEFAULT_TRACE_STEPS = 1 << 20;
+
+void PrintUsage(const char *name) {
+  std::cerr << "Usage: " << name
+            << " [--dispatch loop|threaded|jit] [--check on|off]"
+               " [--trace <file.trace>] [--trace-steps <steps>]"
+               " [--symbols <file.sym>]"
+               " [--profile <profile.txt>] <keys.txt> <file.jack>...\n";
+}
+
+} // namespace
+
+// Compiles the Jack files, runs them headless with the key script, then prints
+// the display and the number of cycles. The wall time and the throughput are
+// reported on stderr, so that stdout only depends on the program
+int main(int argc, char **argv) {
+  Cpu::DispatchMode dispatchMode = Cpu::DispatchMode::LOOP;
+  Cpu::Policy policy = Cpu::Policy::FAST;
+  std::string traceFileName, symbolFileName, profileFileName;
+  std::size_t traceSteps = DEFAULT_TRACE_STEPS;
+  int arg = 1;
+  while (arg + 1 < argc && std::strncmp(argv[arg], "--", 2) == 0) {
+    std::string option = argv[arg], value = argv[arg + 1];
+    if (option == "--dispatch" && value == "loop") {
+      dispatchMode = Cpu::DispatchMode::LOOP;
+    } else if (option == "--dispatch" && value == "threaded") {
+      dispatchMode = Cpu::DispatchMode::THREADED;
+    } else if (option == "--dispatch" && value == "jit") {
+      dispatchMode = Cpu::DispatchMode::JIT;
+    } else if (option == "--check" && (value == "on" || value == "off")) {
+      policy = value == "on" ? Cpu::Policy::CHECKED : Cpu::Policy::FAST;
+    } else if (option == "--trace") {
+      policy = Cpu::Policy::TRACE;
+      traceFileName = value;
+    } else if (option == "--trace-steps" &&
+               value.find_first_not_of("0123456789") == std::string::npos) {
+      traceSteps = std::stoull(value);
+    } else if (option == "--symbols") {
+      symbolFileName = value;
+    } else if (option == "--profile") {
+      policy = Cpu::Policy::PROFILE;
+      profileFileName = value;
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (argc - arg < 2) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<KeyPress> keyPresses;
+  std::vector<Word> program;
+  std::string symbols;
+  try {
+    keyPresses = LoadKeyScript(argv[arg]);
+    program = BuildRom(
+        std::vector<std::string>(argv + arg + 1, argv + argc), &symbols);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  // The whole address space, so that stray accesses stay in bounds
+  std::vector<Word> memory(1 << WORD_WIDTH, 0);
+  auto cpu = std::make_unique<Cpu>();
+  cpu->load(program.data());
+  cpu->setMemoryPtr(memory.data());
+  cpu->setDispatchMode(dispatchMode);
+  cpu->setPolicy(policy);
+  if (!traceFileName.empty()) cpu->setTraceCapacity(traceSteps);
+  cpu->reset();
+
+  std::size_t cycles = 0;
+  for (const auto &keyPress : keyPresses) {
+    cpu->queueKey(keyPress.key, cycles);
+    cycles += keyPress.steps;
+  }
+  // The trace is written even if the program faults, as that is when it is
+  // most useful
+  auto writeTrace = [&] {
+    if (traceFileName.empty()) return;
+    std::ofstream traceFile(traceFileName, std::ios::binary);
+    cpu->trace().write(traceFile, cpu->trace().size());
+  };
+  auto start = std::chrono::steady_clock::now();
+  try {
+    cpu->execute(cycles);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    writeTrace();
+    return 1;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  PrintReport(std::cout, memory.data(), cycles);
+  writeTrace();
+  if (!symbolFileName.empty()) std::ofstream(symbolFileName) << symbols;
+  if (!profileFileName.empty()) {
+    std::ofstream profileFile(profileFileName);
+    PrintProfile(profileFile, symbols, cpu->hits(), cpu->jumps());
+  }
+  std::cerr << "time: " << elapsed.count() << " seconds, "
+            << static_cast<double>(cycles) / elapsed.count() / 1e6
+            << " MIPS\n";
+  return 0;
+}
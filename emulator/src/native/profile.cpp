@@ -0,0 +1,68 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+struct LabelProfile {
+  std::string label;
+  std::uint64_t hits;
+  std::uint64_t jumps;
+};
+
+} // namespace
+
+void PrintProfile(std::ostream &out, const std::string &symbols,
+                  const std::vector<std::uint64_t> &hits,
+                  const std::vector<std::uint64_t> &jumps) {
+  // Where several labels share an address, the last one names the range.
+  // Labels inside a function are prefixed with the function, i.e. the last
+  // label with a dot in it, to show which function a range belongs to
+  std::vector<std::pair<std::size_t, std::string>> labels;
+  labels.emplace_back(0, "(start)");
+  std::stringstream symbolFile(symbols);
+  std::size_t address;
+  std::string label, function;
+  while (symbolFile >> address >> label) {
+    if (label.find('.') != std::string::npos)
+      function = label;
+    else if (!function.empty())
+      label = function + ":" + label;
+    if (labels.back().first == address)
+      labels.back().second = label;
+    else
+      labels.emplace_back(address, label);
+  }
+
+  std::vector<LabelProfile> profiles;
+  std::uint64_t totalHits = 0;
+  for (std::size_t i = 0; i < labels.size(); ++i) {
+    std::size_t begin = std::min(labels[i].first, hits.size());
+    std::size_t end = i + 1 < labels.size() ?
+        std::min(labels[i + 1].first, hits.size()) : hits.size();
+    LabelProfile profile{labels[i].second, 0, 0};
+    for (std::size_t j = begin; j < end; ++j) {
+      profile.hits += hits[j];
+      profile.jumps += jumps[j];
+    }
+    totalHits += profile.hits;
+    if (profile.hits) profiles.push_back(profile);
+  }
+  std::stable_sort(profiles.begin(), profiles.end(),
+      [](const LabelProfile &x, const LabelProfile &y) {
+        return x.hits > y.hits;
+      });
+
+  out << std::setw(14) << "hits" << std::setw(8) << "%"
+      << std::setw(14) << "jumps" << "  label\n";
+  for (const auto &profile : profiles) {
+    out << std::setw(14) << profile.hits << std::setw(8) << std::fixed
+        << std::setprecision(2)
+        << 100.0 * static_cast<double>(profile.hits) /
+           static_cast<double>(totalHits)
+        << std::setw(14) << profile.jumps << "  " << profile.label << "\n";
+  }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Sums the hits and taken jumps of a profiled run per label of the symbol
+// file, i.e. over each address range from one label to the next, and prints
+// them from the most to the least executed
+void PrintProfile(std::ostream &out, const std::string &symbols,
+                  const std::vector<std::uint64_t> &hits,
+                  const std::vector<std::uint64_t> &jumps);
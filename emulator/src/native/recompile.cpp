@@ -0,0 +1,30 @@
+#include "toolchain.h"
+#include "recompiler.h"
+
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+// Usage: HackRecompiler <output.cpp> <file.jack>...
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <output.cpp> <file.jack>...\n";
+    return 1;
+  }
+
+  try {
+    auto program = BuildRom(std::vector<std::string>(argv + 2, argv + argc));
+
+    std::ofstream outputFile(argv[1]);
+    outputFile << Recompile(program.data());
+    if (!outputFile) {
+      std::cerr << "Cannot write " << argv[1] << "\n";
+      return 1;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
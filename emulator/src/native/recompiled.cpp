@@ -0,0 +1,60 @@
+#include "hack.h"
+#include "report.h"
+#include "script.h"
+
+#include <exception>
+#include <iostream>
+#include <vector>
+
+extern const Word RECOMPILED_PROGRAM[ROM_SIZE];
+std::size_t RunRecompiled(
+    Word *memory, Word &pc, Word &registerA, Word &registerD,
+    std::size_t steps);
+
+// Usage: HackRecompiled <keys.txt>
+//
+// Runs the program that was recompiled into this executable with the key
+// script, then prints the display and the number of cycles
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <keys.txt>\n";
+    return 1;
+  }
+
+  std::vector<KeyPress> keyPresses;
+  try {
+    keyPresses = LoadKeyScript(argv[1]);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::vector<MicroOp> microProgram(ROM_SIZE);
+  for (std::size_t i = 0; i < ROM_SIZE; ++i)
+    microProgram[i] = Decode(RECOMPILED_PROGRAM[i]);
+
+  // The whole address space, so that stray accesses stay in bounds
+  std::vector<Word> memory(1 << WORD_WIDTH, 0);
+  Word pc = 0, registerA = 0, registerD = 0;
+  std::size_t cycles = 0;
+  for (const auto &keyPress : keyPresses) {
+    memory[KBD] = keyPress.key;
+    std::size_t steps = keyPress.steps;
+    while (steps) {
+      steps = RunRecompiled(memory.data(), pc, registerA, registerD, steps);
+      if (!steps) break;
+
+      // Not enough steps left for the next block, or pc left the program
+      const MicroOp &op = microProgram[static_cast<std::uint16_t>(pc++) % ROM_SIZE];
+      if (op.alu == AluFunction::LOAD_A)
+        registerA = op.instruction;
+      else
+        ExecuteC(op, memory.data(), pc, registerA, registerD);
+      --steps;
+    }
+    cycles += keyPress.steps;
+  }
+
+  PrintReport(std::cout, memory.data(), cycles);
+  return 0;
+}
@@ -0,0 +1,8 @@
+#include "report.h"
+
+void PrintReport(std::ostream &out, const Word *memory, std::size_t cycles) {
+  out << "display:";
+  for (std::size_t i = 0; i < DISPLAY_SIZE; ++i)
+    out << " " << memory[static_cast<std::size_t>(DISPLAY) + i];
+  out << "\ncycles: " << cycles << "\n";
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "hack.h"
+
+#include <cstddef>
+#include <ostream>
+
+// Prints the display RAM and the number of cycles a run took, in the same
+// format for every native runner so that their outputs can be compared
+void PrintReport(std::ostream &out, const Word *memory, std::size_t cycles);
@@ -0,0 +1,63 @@
+#include "script.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr Word KEY_BLANK = 19;
+
+const std::unordered_map<std::string, Word> KEY_NAMES = {
+  {"+", 10},
+  {"-", 11},
+  {"*", 12},
+  {"/", 13},
+  {"s", 14},
+  {"=", 15},
+  {"c", 16},
+  {".", 17},
+  {"n", 18},
+  {"none", KEY_BLANK}
+};
+
+Word ParseKey(const std::string &str, std::size_t lineNumber) {
+  if (!str.empty() && std::all_of(str.begin(), str.end(),
+        [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+    return static_cast<Word>(std::stoi(str));
+
+  auto it = KEY_NAMES.find(str);
+  if (it == KEY_NAMES.end())
+    throw std::runtime_error("Line " + std::to_string(lineNumber) +
+        ": invalid key \"" + str + "\"");
+  return it->second;
+}
+
+} // namespace
+
+std::vector<KeyPress> LoadKeyScript(const std::string &fileName) {
+  std::ifstream inputFile(fileName);
+  if (!inputFile)
+    throw std::runtime_error("Cannot open " + fileName);
+
+  std::vector<KeyPress> keyPresses;
+  std::string line;
+  std::size_t lineNumber = 0;
+  while (std::getline(inputFile, line)) {
+    ++lineNumber;
+    std::stringstream input(line);
+    std::string key;
+    if (!(input >> key) || key.front() == '#') continue;
+
+    long long steps;
+    if (!(input >> steps) || steps < 0)
+      throw std::runtime_error("Line " + std::to_string(lineNumber) +
+          ": expected a number of steps after the key");
+    keyPresses.push_back({ParseKey(key, lineNumber),
+                          static_cast<std::size_t>(steps)});
+  }
+  return keyPresses;
+}
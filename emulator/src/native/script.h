@@ -0,0 +1,22 @@
+#pragma once
+
+#include "hack.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A key script holds one key press per line, written as
+//
+//   <key> <steps>
+//
+// which keeps <key> in KBD for the next <steps> instructions. <key> is either
+// a key code or one of the characters the web frontend accepts (0-9, +, -, *,
+// /, s, =, c, . and n); "none" releases all keys. Empty lines and lines
+// starting with '#' are ignored
+struct KeyPress {
+  Word key;
+  std::size_t steps;
+};
+
+std::vector<KeyPress> LoadKeyScript(const std::string &fileName);
@@ -0,0 +1,58 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(std::size_t threads) :
+  threads_(threads ? threads
+                   : std::max<std::size_t>(std::thread::hardware_concurrency(),
+                                           1)),
+  queues_()
+{
+  for (std::size_t i = 0; i < threads_; ++i)
+    queues_.push_back(std::make_unique<Queue>());
+}
+
+std::size_t WorkStealingPool::threads() const {
+  return threads_;
+}
+
+void WorkStealingPool::run(
+    std::size_t jobs,
+    const std::function<void(std::size_t, std::size_t)> &task) {
+  // Every job is queued before any thread starts, so a thread that finds all
+  // the queues empty is done for good
+  for (std::size_t job = 0; job < jobs; ++job)
+    queues_[job % threads_]->jobs.push_back(job);
+
+  auto work = [this, &task](std::size_t thread) {
+    std::size_t job;
+    while (pop(thread, job) || steal(thread, job)) task(job, thread);
+  };
+  std::vector<std::thread> workers;
+  for (std::size_t thread = 1; thread < threads_; ++thread)
+    workers.emplace_back(work, thread);
+  work(0);
+  for (auto &worker : workers) worker.join();
+}
+
+bool WorkStealingPool::pop(std::size_t thread, std::size_t &job) {
+  Queue &queue = *queues_[thread];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty()) return false;
+  job = queue.jobs.back();
+  queue.jobs.pop_back();
+  return true;
+}
+
+bool WorkStealingPool::steal(std::size_t thread, std::size_t &job) {
+  for (std::size_t i = 1; i < threads_; ++i) {
+    Queue &queue = *queues_[(thread + i) % threads_];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) continue;
+    job = queue.jobs.front();
+    queue.jobs.pop_front();
+    return true;
+  }
+  return false;
+}
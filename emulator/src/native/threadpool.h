@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Runs a batch of independent jobs on a fixed number of threads. Each thread
+// has its own queue of jobs, works through it from the back and, once it is
+// empty, steals from the front of the others, so that a few slow jobs do not
+// keep the rest of the threads waiting
+class WorkStealingPool {
+public:
+  // Zero threads means one per hardware thread
+  explicit WorkStealingPool(std::size_t threads = 0);
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool &) = delete;
+
+  std::size_t threads() const;
+  // Calls task(job, thread) once for every job in [0, jobs) and returns when
+  // all of them are done. thread is in [0, threads()), so that the task can
+  // keep per-thread state. The task must not throw
+  void run(std::size_t jobs,
+           const std::function<void(std::size_t, std::size_t)> &task);
+
+private:
+  struct Queue {
+    Queue() : mutex(), jobs() {}
+
+    std::mutex mutex;
+    std::deque<std::size_t> jobs;
+  };
+
+  bool pop(std::size_t thread, std::size_t &job);
+  bool steal(std::size_t thread, std::size_t &job);
+
+  std::size_t threads_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+};
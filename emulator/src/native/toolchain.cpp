@@ -0,0 +1,61 @@
+#include "toolchain.h"
+
+#include "tokenizer.h"
+#include "parser.h"
+#include "vmcommand.h"
+#include "translator.h"
+#include "assembler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Parses the Jack file the same way CompileFile does in the web frontend,
+// which names it after the file alone
+VMCommands Compile(const std::string &jackFileName) {
+  std::ifstream inputFile(jackFileName);
+  if (!inputFile)
+    throw std::runtime_error("Cannot open " + jackFileName);
+  std::stringstream input;
+  input << inputFile.rdbuf();
+
+  auto fileName = std::filesystem::path(jackFileName).filename().string();
+  return Parser(fileName, input.str()).toVMCommands();
+}
+
+} // namespace
+
+std::vector<Word> BuildRom(const std::vector<std::string> &jackFileNames,
+                           std::string *symbols) {
+  Tokenizer::init();
+  Parser::reset();
+
+  Translator translator;
+  for (const auto &jackFileName : jackFileNames) {
+    auto fileName = std::filesystem::path(jackFileName).filename().string();
+    translator.translateFile(fileName,
+                             Compile(jackFileName).toVMCodeString());
+  }
+
+  auto machineCode = Assembler::assemble(translator.getAssembly(), symbols);
+  if (machineCode.size() > ROM_SIZE)
+    throw std::runtime_error("Program does not fit into the ROM");
+  std::vector<Word> program(ROM_SIZE, 0);
+  std::copy(machineCode.begin(), machineCode.end(), program.begin());
+  return program;
+}
+
+VMCommands BuildVmCommands(const std::vector<std::string> &jackFileNames) {
+  Tokenizer::init();
+  Parser::reset();
+
+  VMCommands vmCommands;
+  vmCommands.clear();
+  for (const auto &jackFileName : jackFileNames)
+    vmCommands.add(Compile(jackFileName));
+  return vmCommands;
+}
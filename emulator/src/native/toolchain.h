@@ -0,0 +1,17 @@
+#pragma once
+
+#include "hack.h"
+#include "vmcommand.h"
+
+#include <string>
+#include <vector>
+
+// Compiles, translates and assembles the Jack files the same way the web
+// frontend does, and returns the resulting ROM. If symbols is given, it is set
+// to the assembler's symbol file
+std::vector<Word> BuildRom(const std::vector<std::string> &jackFileNames,
+                           std::string *symbols = nullptr);
+
+// Compiles the Jack files the same way the web frontend does, and returns
+// their VM commands linked into one program
+VMCommands BuildVmCommands(const std::vector<std::string> &jackFileNames);
@@ -0,0 +1,38 @@
+#include "trace.h"
+
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Usage: HackTraceDecoder <file.trace>
+//
+// Prints a trace written by HackEmulatorCli --trace as text, one step per line,
+// oldest first: pc, A and D after the step, then the address and value of the
+// word it wrote, if any
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <file.trace>\n";
+    return 1;
+  }
+
+  std::vector<TraceEntry> entries;
+  try {
+    std::ifstream traceFile(argv[1], std::ios::binary);
+    if (!traceFile)
+      throw std::runtime_error(std::string("Cannot open ") + argv[1]);
+    entries = ReadTrace(traceFile);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  for (const auto &entry : entries) {
+    std::cout << entry.pc << " " << entry.a << " " << entry.d;
+    if (entry.wrote) std::cout << " " << entry.address << "=" << entry.value;
+    std::cout << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "toolchain.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t DEFAULT_LENGTH = 5;
+constexpr std::size_t DEFAULT_TOP = 30;
+
+void PrintUsage(const char *name) {
+  std::cerr << "Usage: " << name
+            << " [--length <commands>] [--top <count>] <file.jack>...\n";
+}
+
+// A command with its operands replaced by '_', except for constants, whose
+// value often decides whether a sequence is worth fusing
+std::string Shape(const std::string &command) {
+  std::stringstream input(command);
+  std::string op, segment;
+  input >> op;
+  if (op == "push" || op == "pop") {
+    input >> segment;
+    if (segment == "constant") return command;
+    return op + " " + segment + " _";
+  }
+  if (op == "goto" || op == "if-goto") return op + " _";
+  if (op == "call") return "call _";
+  return op;
+}
+
+// Jumps into the middle of a sequence or returns to it would skip part of a
+// fused command, so control flow may only end a sequence
+bool MayContinue(const std::string &shape) {
+  return shape.rfind("goto", 0) != 0 && shape.rfind("if-goto", 0) != 0 &&
+         shape.rfind("call", 0) != 0 && shape != "return";
+}
+
+} // namespace
+
+// Compiles the Jack files and prints how often each sequence of VM commands
+// appears in them, which is what the superinstructions of the VM interpreter
+// are picked from. Sequences never span a label or a function
+int main(int argc, char **argv) {
+  std::size_t length = DEFAULT_LENGTH, top = DEFAULT_TOP;
+  int arg = 1;
+  while (arg + 1 < argc && std::strncmp(argv[arg], "--", 2) == 0) {
+    std::string option = argv[arg], value = argv[arg + 1];
+    bool isNumber = !value.empty() &&
+        value.find_first_not_of("0123456789") == std::string::npos;
+    if (option == "--length" && isNumber) {
+      length = std::stoull(value);
+    } else if (option == "--top" && isNumber) {
+      top = std::stoull(value);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (arg == argc || length < 2) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> shapes;
+  try {
+    auto vmCommands =
+        BuildVmCommands(std::vector<std::string>(argv + arg, argv + argc));
+    std::stringstream vmCode(vmCommands.toVMCodeString());
+    std::string command;
+    while (std::getline(vmCode, command)) shapes.push_back(Shape(command));
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::map<std::string, std::size_t> counts;
+  for (std::size_t begin = 0; begin < shapes.size(); ++begin) {
+    std::string sequence;
+    for (std::size_t end = begin; end < shapes.size() && end - begin < length;
+         ++end) {
+      const std::string &shape = shapes[end];
+      if (shape == "label" || shape == "function") break;
+      sequence += (end == begin ? "" : "; ") + shape;
+      if (end > begin) ++counts[sequence];
+      if (!MayContinue(shape)) break;
+    }
+  }
+
+  std::vector<std::pair<std::string, std::size_t>> sorted(counts.begin(),
+                                                          counts.end());
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const auto &a, const auto &b) {
+                     return a.second > b.second;
+                   });
+  sorted.resize(std::min(sorted.size(), top));
+  for (const auto &[sequence, count] : sorted)
+    std::cout << count << "\t" << sequence << "\n";
+  return 0;
+}
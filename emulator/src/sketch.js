@@ -16,6 +16,7 @@ let vmCodeStrings = {};
 let assemblyString;
 let machineCode = [];
 let progName;
+let ipsText;
 const ROM_SIZE = 32768;
 // TODO: change this later
 const RAM_SIZE = 24577;
@@ -45,6 +46,9 @@ const KEY_CLEAR = 16;
 const KEY_POINT = 17;
 const KEY_NEG = 18;
 const KEY_BLANK = 19;
+const STATUS_HALTED = 1;
+// The speed slider is in instructions per frame at this rate
+const FRAME_RATE = 60;
 const BACKGROUND_COLOR = 230;
 
 function saveFile(contents, filename, type = "text/plain") {
@@ -168,8 +172,6 @@ function setup() {
   };
 
   setTimeout(() => {
-    Module.ccall("Init", null, [], []);
-
     const memory = new INT_ARRAY[WORD_SIZE](RAM_SIZE);
     const buf = Module._malloc(memory.length * memory.BYTES_PER_ELEMENT);
     bufBegin = buf / memory.BYTES_PER_ELEMENT;
@@ -204,6 +206,7 @@ function setup() {
     execute.mousePressed(() => {
       execute.attribute('disabled', '');
       console.log('Starting execution...');
+      Module.ccall('StartWorker');
       start = true;
     });
 
@@ -242,9 +245,17 @@ function setup() {
     });
     const speedSlider = select('#speed');
     speed = speedSlider.value();
+    Module.ccall('SetWorkerSpeed', null, ['number'], [speed * FRAME_RATE]);
     speedSlider.changed(() => {
       speed = speedSlider.value();
+      Module.ccall('SetWorkerSpeed', null, ['number'], [speed * FRAME_RATE]);
     });
+    ipsText = document.getElementById('ips');
+    setInterval(() => {
+      const ips = Module.ccall('GetWorkerInstructionsPerSecond', 'number',
+                               [], []);
+      ipsText.textContent = (ips / 1e6).toFixed(1) + ' MIPS';
+    }, 1000);
   }, 1000);
 
   createCanvas(DIGIT_WIDTH * NUM_DIGITS, DIGIT_HEIGHT).parent('canvas');
@@ -259,13 +270,20 @@ function draw() {
 }
 
 function nextFrame() {
-  if (Module.ccall('Execute', 'number', ['number'], [speed])) {
+  // The CPU runs on its own thread; a frame only picks up its latest display
+  // and repaints the digits that changed since the last frame
+  const changes = Module.ccall('UpdateWorker', 'number', [], []);
+  if (Module.ccall('GetWorkerStatus', 'number', [], []) == STATUS_HALTED) {
     console.log('Program halted.');
+    Module.ccall('StopWorker');
     execute.attribute('disabled', '');
     start = false;
   }
 
-  const memory = Module[HEAP[WORD_SIZE]].subarray(bufBegin, bufEnd);
+  const displayBegin =
+      Module.ccall('GetWorkerDisplay', 'number', [], []) / WORD_SIZE;
+  const display = Module[HEAP[WORD_SIZE]].subarray(
+      displayBegin, displayBegin + NUM_DIGITS);
 
   const rects = [
       {vert: false, x: MARGIN + SEGMENT_WIDTH, y: MARGIN},
@@ -281,7 +299,9 @@ function nextFrame() {
                     y: MARGIN + SEGMENT_WIDTH + SEGMENT_HEIGHT}
   ];
   for (let i = 0; i < NUM_DIGITS; ++i) {
-    const cur = memory[DISPLAY_ADDRESS + NUM_DIGITS - i - 1];
+    if (!((changes >> (NUM_DIGITS - i - 1)) & 1))
+      continue;
+    const cur = display[NUM_DIGITS - i - 1];
     let j = 0;
     for (const r of rects) {
       const x = DIGIT_WIDTH * i + r.x;
@@ -311,61 +331,70 @@ function nextFrame() {
       fill(BACKGROUND_COLOR);
     rect(x, y, w, h);
   }
+}
+
+// Every press and release is queued in the emulator, which holds each key long
+// enough for the program to see it, so fast typing is never lost
+function keyPressed() {
+  if (start) Module.ccall('PushKey', 'number', ['number'], [hackKey()]);
+}
+
+function keyReleased() {
+  if (start) Module.ccall('PushKey', 'number', ['number'], [KEY_BLANK]);
+}
 
+function hackKey() {
   let pressedKey = KEY_BLANK;
-  if (keyIsPressed) {
-    switch (key) {
-      case "0":
-      case "1":
-      case "2":
-      case "3":
-      case "4":
-      case "5":
-      case "6":
-      case "7":
-      case "8":
-      case "9":
-        pressedKey = parseInt(key);
-        break;
-      case "+":
-        pressedKey = KEY_ADD;
-        break;
-      case "-":
-        pressedKey = KEY_SUB;
-        break;
-      case "*":
-        pressedKey = KEY_MUL;
-        break;
-      case "/":
-        pressedKey = KEY_DIV;
-        break;
-      case "S":
-      case "s":
-        pressedKey = KEY_SQRT;
-        break;
-      case "=":
-        pressedKey = KEY_EQUAL;
-        break;
-      case "C":
-      case "c":
-        pressedKey = KEY_CLEAR;
-        break;
-      case ".":
-        pressedKey = KEY_POINT;
-        break;
-      case "N":
-      case "n":
-        pressedKey = KEY_NEG;
-        break;
-      default:
-        pressedKey = KEY_BLANK;
-        break;
-    }
-    switch (keyCode) {
-      case ENTER:
-        pressedKey = KEY_EQUAL;
-    }
+  switch (key) {
+    case "0":
+    case "1":
+    case "2":
+    case "3":
+    case "4":
+    case "5":
+    case "6":
+    case "7":
+    case "8":
+    case "9":
+      pressedKey = parseInt(key);
+      break;
+    case "+":
+      pressedKey = KEY_ADD;
+      break;
+    case "-":
+      pressedKey = KEY_SUB;
+      break;
+    case "*":
+      pressedKey = KEY_MUL;
+      break;
+    case "/":
+      pressedKey = KEY_DIV;
+      break;
+    case "S":
+    case "s":
+      pressedKey = KEY_SQRT;
+      break;
+    case "=":
+      pressedKey = KEY_EQUAL;
+      break;
+    case "C":
+    case "c":
+      pressedKey = KEY_CLEAR;
+      break;
+    case ".":
+      pressedKey = KEY_POINT;
+      break;
+    case "N":
+    case "n":
+      pressedKey = KEY_NEG;
+      break;
+    default:
+      pressedKey = KEY_BLANK;
+      break;
   }
-  Module.ccall('SetKey', null, ['number'], [pressedKey]);
+  switch (keyCode) {
+    case ENTER:
+      pressedKey = KEY_EQUAL;
+  }
+  return pressedKey;
 }
-